@@ -19,7 +19,9 @@
  * - Adafruit NeoPixel by Adafruit v1.12.3
  * - ArduinoOTA by Arduino, Juraj Andrasy v1.1.0
  * - Arduino_DebugUtils by Arduino v1.4.0
- * - webserver came as an example with esp8266 board package
+ * - ESPAsyncTCP and ESPAsyncWebServer by me-no-dev (async, callback driven web server)
+ * - webserver came as an example with esp8266 board package (the web layer has
+ *   since been moved to ESPAsyncWebServer; the config SoftAP still uses ESP8266WebServer)
  *
  * Default Pin Assignments(see app_pins.h):
  * Pin      Function                #define 
@@ -81,6 +83,7 @@
  * index.html .........................................MechWarriorsWebNeopixels.ino
  * html/button .............callCfunction() ...........handleButton() 
  * html button "value" -> js o.value -> POST body -> server.arg("plain")
+ * (since the move to the async server the body is collected by handleButtonBody())
  *
  *
  * How to parse/deserialize a simple json string?
@@ -191,7 +194,9 @@
 // 21.07.2021 creation, first version
 
 #include <Arduino.h>
-#include <ESP8266WebServer.h>
+#include <ESP8266WiFi.h>
+#include <ESPAsyncTCP.h>
+#include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include <Arduino_DebugUtils.h>
 
@@ -203,7 +208,15 @@
 #include <ESP8266TimerInterrupt.h>  // neopixel timer
 
 #include "bt_eepromlib.h"
+#include "bt_wifilib.h"
+#include "bt_jsonpool.h"  // arena for the json documents
+#include "bt_memlib.h"    // memory telemetry
+#include "bt_fsio.h"      // flash I/O accounting
+#include "bt_loglib.h"    // DEBUG_* go through a ring buffer (see /$log)
 #include "neo_data.h"  // for neopixels
+#include "neo_udp.h"   // pixel streaming (DDP, E1.31)
+#include "neo_sync.h"  // keeping several boards in step
+#include "neo_lib.h"   // index of the sequence files
 #include "app_pins.h"
 #include "configSoftAP.h"
 
@@ -221,8 +234,8 @@
 
 // get access to the eeprom based configuration structure
 net_config *pmon_config = get_mon_config_ptr();
+const config_values *pconfig = get_config_values();
 
-#ifdef CONFIG_SERVER
 /*
  * part of figuring out why, after sitting a while, the first button press
  * takes 5-10 seconds to work.  Although, clicking in the address line
@@ -232,116 +245,492 @@ net_config *pmon_config = get_mon_config_ptr();
  * Update: seems to have been helped by calling the neopixel update
  * on a timer so that the webserver update call gets more time.
  *
- * was trying to follow this ... not sure it's for this implementation:
- * https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/protocols/esp_http_server.html#_CPPv414httpd_config_t
- * 
- * Configure the HTTP server ... this code doesn't compile; for reference only
- * default max_open_sockets is apparently 4
- * keep-alive: Defaults to true when the client's HTTP version is 1.1 or above, otherwise it defaults to false.
- */
-HTTPD_DEFAULT_CONFIG();
-
-httpd_config_t config = { 
-  .max_open_sockets = 5,  //default
-  .server_port = 80;
-  .keep_alive_enable = true;
-  .keep_alive_idle = 5;  //default
-  .keep_alive_interval = 5; // default
-  .keep_alive_count = 3; // default
-};
-// Start the server
-ESP8266WebServer server(config);
-
-#else
-/*
+ * Update: the synchronous ESP8266WebServer ran every request (including
+ * uploads and the 160K background.png) to completion inside loop(), holding
+ * off neo_cycle_next() the whole time.  The server is now the async,
+ * callback driven AsyncWebServer: requests are parsed and responses sent
+ * from the TCP callbacks a window-sized slice at a time, so loop() is left
+ * to the neopixels and no longer calls handleClient().
+ *
  * need a WebServer for http access on port 80.
  */
-ESP8266WebServer server(80);
-
-#endif
+AsyncWebServer server(80);
 
 // The text of builtin files are in this header file
 #include "builtinfiles.h"
 
+// web pages built into the firmware by tools/make_webbundle.py (optional)
+#if __has_include("webbundle.h")
+#include "webbundle.h"
+#define WEB_BUNDLE
+#endif
+
+#ifdef WEB_BUNDLE
+// ===== Web pages served from the firmware =====
+//
+// the bundled files are answered straight out of flash with the ETag and
+// content type worked out at build time, so there are no file system
+// lookups for them at all.  a browser revalidating with If-None-Match
+// gets a 304 without any content.
+// a file of the same name (or name.gz) in LittleFS overrides the bundled one,
+// so pages can still be changed with $upload.htm without a firmware update.
+// which ones are overridden is looked up once at boot and (from loop())
+// after each upload/delete rather than for every request.
+
+static bool web_bundle_override[WEB_BUNDLE_COUNT];
+static volatile bool web_bundle_dirty = false;  // rescan from loop(), see webBundleInvalidate()
+
+// @return index in web_bundle[] of the url, -1 if it isn't bundled
+int8_t webBundleFind(const char *url)  {
+  for(int8_t i = 0; i < WEB_BUNDLE_COUNT; i++)  {
+    if(strcmp_P(url, (const char *)pgm_read_ptr(&web_bundle[i].path)) == 0)
+      return(i);
+  }
+  return(-1);
+}
+
+void webBundleScan(void)  {
+  char path[64];
+
+  for(int8_t i = 0; i < WEB_BUNDLE_COUNT; i++)  {
+    strncpy_P(path, (const char *)pgm_read_ptr(&web_bundle[i].path), sizeof(path) - 4);
+    path[sizeof(path) - 4] = '\0';
+    web_bundle_override[i] = LittleFS.exists(path);
+    strcat(path, ".gz");
+    web_bundle_override[i] = web_bundle_override[i] || LittleFS.exists(path);
+    if(web_bundle_override[i])
+      DEBUG_INFO("%s is overridden by the file system\n", path);
+  }
+  web_bundle_dirty = false;
+}
+
+// the files changed, rescan from loop() rather than in a server callback
+void webBundleInvalidate(void)  {
+  web_bundle_dirty = true;
+}
+
+void webBundleService(void)  {
+  if(web_bundle_dirty == true)
+    webBundleScan();
+}
+
+class WebBundleHandler : public AsyncWebHandler {
+public:
+  WebBundleHandler() {
+    DEBUG_INFO("WebBundleHandler is registered with %d files\n", WEB_BUNDLE_COUNT);
+  }
+
+  bool canHandle(AsyncWebServerRequest *request) override {
+    int8_t idx;
+
+    if(request->method() != HTTP_GET)
+      return(false);
+    if(((idx = webBundleFind(request->url().c_str())) < 0) || web_bundle_override[idx])
+      return(false);
+    request->addInterestingHeader("If-None-Match");
+    request->addInterestingHeader("Accept-Encoding");
+    return(true);
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    web_asset_t asset;
+    AsyncWebServerResponse *response;
+    int8_t idx = webBundleFind(request->url().c_str());
+
+    if(idx < 0)  {  // can't happen, canHandle() found it
+      request->send(404);
+      return;
+    }
+    memcpy_P(&asset, &web_bundle[idx], sizeof(asset));
+
+    if(request->hasHeader("If-None-Match") &&
+       (strcmp_P(request->header("If-None-Match").c_str(), asset.etag) == 0))  {
+      response = request->beginResponse(304);
+    }
+    else if(asset.gzip && (!request->hasHeader("Accept-Encoding") ||
+                           (request->header("Accept-Encoding").indexOf("gzip") < 0)))  {
+      request->send(406, "text/plain", "gzip encoding required");
+      return;
+    }
+    else  {
+      response = request->beginResponse_P(200, String(FPSTR(asset.type)), asset.data, asset.len);
+      if(asset.gzip)
+        response->addHeader("Content-Encoding", "gzip");
+    }
+    response->addHeader("ETag", String(FPSTR(asset.etag)));
+    response->addHeader("Cache-Control", String(FPSTR(asset.cache)));
+    request->send(response);
+  }
+};
+#endif  // WEB_BUNDLE
+
 // ===== Simple functions used to answer simple GET requests =====
 
 // This function is called when the WebServer was requested without giving a filename.
 // This will redirect to the file index.htm when it is existing otherwise to the built-in $upload.htm page
 //
 // this is used to display the main page after having uploaded a index.htm page with buttons
-void handleRedirect() {
+void handleRedirect(AsyncWebServerRequest *request) {
   DEBUG_INFO("Redirect...\n");
-  String url = "/index.htm";
+  const char *url = "/index.htm";
 
-  if (!LittleFS.exists(url)) { url = "/$update.htm"; }
+  // the page may only be there precompressed (see serveStatic() below)
+  // or built into the firmware
+#ifdef WEB_BUNDLE
+  if (webBundleFind(url) >= 0) { request->redirect(url); return; }
+#endif
+  if (!LittleFS.exists(url) && !LittleFS.exists("/index.htm.gz")) { url = "/$upload.htm"; }
 
-  server.sendHeader("Location", url, true);
-  server.send(302);  // send "found redirection" return code
+  request->redirect(url);  // send "found redirection" return code
 }  // handleRedirect()
 
 
+// Cache-Control for static files that never change (a year, the usual maximum)
+#define STATIC_IMMUTABLE "public, max-age=31536000, immutable"
+
+
+// ===== Streamed (chunked) JSON responses =====
+//
+// the service responses below are produced by a generator function that is
+// called with an increasing step number and formats the next small piece of
+// the response into a fixed buffer.  the async server pulls the pieces with
+// chunk_fill() as the TCP window allows and sends them with chunked
+// transfer encoding, so nothing is accumulated on the heap and heap use
+// doesn't grow with the size of the response (e.g. the number of files).
+
+#define CHUNK_BUF_SIZE 128
+
+struct chunk_state {
+  bool (*gen)(chunk_state *st, uint32_t step);  // returns false when there is nothing more to send
+  uint32_t step;
+  bool done;
+  char buf[CHUNK_BUF_SIZE];
+  size_t len;  // characters in buf
+  size_t off;  // characters of buf already sent
+  Dir dir;     // used by the file list generator
+  bool last;   // used by the file list generator
+  log_cursor_t log;  // used by the log generator
+};
+
+// printf() onto the end of the pending piece (truncated if too long)
+void chunk_printf(chunk_state *st, const char *fmt, ...) {
+  va_list args;
+  int len;
+
+  va_start(args, fmt);
+  len = vsnprintf(st->buf + st->len, CHUNK_BUF_SIZE - st->len, fmt, args);
+  va_end(args);
+
+  if (len > 0) { st->len = ((st->len + len) >= CHUNK_BUF_SIZE ? (CHUNK_BUF_SIZE - 1) : (st->len + len)); }
+}
+
+// add a quoted, escaped json string
+void chunk_json_string(chunk_state *st, const char *str) {
+  chunk_printf(st, "\"");
+  for (; *str != '\0'; str++) {
+    if ((*str == '"') || (*str == '\\')) { chunk_printf(st, "\\%c", *str); }
+    else if ((uint8_t)*str < 0x20) { chunk_printf(st, "\\u%04x", *str); }
+    else { chunk_printf(st, "%c", *str); }
+  }
+  chunk_printf(st, "\"");
+}
+
+// the AwsResponseFiller: copy out as much as fits, generating more pieces as needed
+size_t chunk_fill(std::shared_ptr<chunk_state> st, uint8_t *out, size_t maxLen) {
+  size_t n = 0;
+
+  while (n < maxLen) {
+    if (st->off >= st->len) {
+      if (st->done) { break; }
+      st->len = st->off = 0;
+      st->done = !st->gen(st.get(), st->step++);
+    } else {
+      size_t c = std::min(maxLen - n, st->len - st->off);
+      memcpy(out + n, st->buf + st->off, c);
+      n += c;
+      st->off += c;
+    }
+  }
+  return (n);  // 0 ends the response
+}
+
+// start a chunked response of the given content type driven by the generator gen
+void chunk_send_type(AsyncWebServerRequest *request, const char *type, bool (*gen)(chunk_state *st, uint32_t step)) {
+  std::shared_ptr<chunk_state> st = std::make_shared<chunk_state>();
+  st->gen = gen;
+  st->step = 0;
+  st->done = false;
+  st->len = st->off = 0;
+  st->last = false;
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(type,
+    [st](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return (chunk_fill(st, buffer, maxLen));
+    });
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+// start a chunked json response driven by the generator gen
+void chunk_send(AsyncWebServerRequest *request, bool (*gen)(chunk_state *st, uint32_t step)) {
+  chunk_send_type(request, "application/json; charset=utf-8", gen);
+}
+
+
 // This function is called when the WebServer was requested to list all existing files in the filesystem.
 // a JSON array with file information is returned.
-void handleListFiles() {
-  Dir dir = LittleFS.openDir("/");
-  String result;
-
-  result += "[\n";
-  while (dir.next()) {
-    if (result.length() > 4) { result += ","; }
-    result += "  {";
-    result += " \"name\": \"" + dir.fileName() + "\", ";
-    result += " \"size\": " + String(dir.fileSize()) + ", ";
-    result += " \"time\": " + String(dir.fileTime());
-    result += " }\n";
-    // jc.addProperty("size", dir.fileSize());
-  }  // while
-  result += "]";
-  server.sendHeader("Cache-Control", "no-cache");
-  server.send(200, "text/javascript; charset=utf-8", result);
+bool genListFiles(chunk_state *st, uint32_t step) {
+  if (step == 0) {
+    st->dir = LittleFS.openDir("/");
+    chunk_printf(st, "[\n");
+  } else if (st->last) {
+    return (false);
+  } else if (st->dir.next()) {
+    chunk_printf(st, "%s  { \"name\": ", (step == 1 ? "" : ",\n"));
+    chunk_json_string(st, st->dir.fileName().c_str());
+    chunk_printf(st, ", \"size\": %u, \"time\": %ld }", st->dir.fileSize(), (long)st->dir.fileTime());
+  } else {
+    chunk_printf(st, "\n]\n");
+    st->last = true;
+  }
+  return (true);
+}  // genListFiles()
+
+void handleListFiles(AsyncWebServerRequest *request) {
+  chunk_send(request, genListFiles);
 }  // handleListFiles()
 
 
-// This function is called when the sysInfo service was requested.
-void handleSysInfo() {
-  String result;
+// the sequences the button page can offer: the built-ins, then the
+// sequence files from the index (see neo_lib.cpp), each file in two
+// pieces so that the long strings fit.
+bool genSequences(chunk_state *st, uint32_t step) {
+  char buf[MAX_NEO_LABEL];
+  uint32_t files = 2 * (uint32_t)neo_lib_count();
+
+  if (step == 0) {
+    chunk_printf(st, "{ \"sequences\": [\n");
+  } else if (step <= NEO_BUILTIN_SEQ) {
+    strncpy_P(buf, (const char *)pgm_read_ptr(&neo_builtins[step - 1].label), sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    chunk_printf(st, "%s  { \"label\": ", (step == 1 ? "" : ",\n"));
+    chunk_json_string(st, buf);
+    neo_get_strategy(step - 1, buf);
+    chunk_printf(st, ", \"strategy\": \"%s\", \"builtin\": true }", buf);
+  } else if (step <= (NEO_BUILTIN_SEQ + files)) {
+    const neo_lib_entry_t *entry = neo_lib_get((step - NEO_BUILTIN_SEQ - 1) / 2);
+    if (entry == NULL) {  // the index was rebuilt smaller in the meantime
+      chunk_printf(st, " ");
+    } else if (((step - NEO_BUILTIN_SEQ - 1) % 2) == 0) {
+      chunk_printf(st, ",\n  { \"label\": ");
+      chunk_json_string(st, entry->label);
+      chunk_printf(st, ", \"file\": ");
+      chunk_json_string(st, entry->file);
+    } else {
+      chunk_printf(st, ", \"strategy\": \"%s\", \"size\": %u, \"points\": %u }", entry->strategy, entry->size, entry->points);
+    }
+  } else if (step == (NEO_BUILTIN_SEQ + files + 1)) {
+    chunk_printf(st, "\n] }\n");
+  } else {
+    return (false);
+  }
+  return (true);
+}  // genSequences()
+
+void handleSequences(AsyncWebServerRequest *request) {
+  chunk_send(request, genSequences);
+}  // handleSequences()
 
+
+// This function is called when the sysInfo service was requested.
+bool genSysInfo(chunk_state *st, uint32_t step) {
   FSInfo fs_info;
-  LittleFS.info(fs_info);
-
-  result += "{\n";
-  result += "  \"flashSize\": " + String(ESP.getFlashChipSize()) + ",\n";
-  result += "  \"freeHeap\": " + String(ESP.getFreeHeap()) + ",\n";
-  result += "  \"fsTotalBytes\": " + String(fs_info.totalBytes) + ",\n";
-  result += "  \"fsUsedBytes\": " + String(fs_info.usedBytes) + ",\n";
-  result += "  \"Chip ID\": " + String(ESP.getChipId()) + ",\n";
-  result += "  \"CPU Frequency\": " + String(ESP.getCpuFreqMHz()) + "MHz" + ",\n";
-  result += "  \"firmware version\": " + String(EEPROM_VALID) + ",\n";
-  result += "}";
-
-  server.sendHeader("Cache-Control", "no-cache");
-  server.send(200, "text/javascript; charset=utf-8", result);
+
+  switch (step) {
+    case 0:
+      chunk_printf(st, "{\n");
+      chunk_printf(st, "  \"flashSize\": %u,\n", ESP.getFlashChipSize());
+      chunk_printf(st, "  \"freeHeap\": %u,\n", ESP.getFreeHeap());
+      break;
+    case 1:
+      fsio_info(FSIO_FS_INFO, fs_info);
+      chunk_printf(st, "  \"fsTotalBytes\": %u,\n", fs_info.totalBytes);
+      chunk_printf(st, "  \"fsUsedBytes\": %u,\n", fs_info.usedBytes);
+      chunk_printf(st, "  \"configWrites\": %u,\n", (unsigned)pconfig->generation);
+      break;
+    case 2:
+      chunk_printf(st, "  \"heapFragmentation\": %u,\n", ESP.getHeapFragmentation());
+      chunk_printf(st, "  \"maxFreeBlock\": %u,\n", ESP.getMaxFreeBlockSize());
+      break;
+    case 3: {
+      const json_pool_stats_t *pool = json_pool_get_stats();
+      chunk_printf(st, "  \"jsonPool\": { \"size\": %u, \"used\": %u, \"peak\": %u, \"allocs\": %u, \"fallbacks\": %u },\n",
+                   JSON_POOL_SIZE, pool->used, pool->peak, pool->allocs, pool->fallbacks);
+      } break;
+    case 4:
+      chunk_printf(st, "  \"Chip ID\": %u,\n", ESP.getChipId());
+      chunk_printf(st, "  \"CPU Frequency\": \"%uMHz\",\n", ESP.getCpuFreqMHz());
+      chunk_printf(st, "  \"firmware version\": \"%s\"\n", EEPROM_VALID);
+      chunk_printf(st, "}\n");
+      break;
+    default:
+      return (false);
+  }
+  return (true);
+}  // genSysInfo()
+
+void handleSysInfo(AsyncWebServerRequest *request) {
+  chunk_send(request, genSysInfo);
 }  // handleSysInfo()
 
+// where the RAM is going, one subsystem per step (see bt_memlib.cpp)
+bool genMemory(chunk_state *st, uint32_t step) {
+  const mem_stats_t *mem;
+  mem_use_t use;
+
+  if (step == 0) {
+    mem = mem_get_stats();
+    chunk_printf(st, "{\n  \"static\": %u, \"budget\": %u,\n", mem->static_total, MEM_STATIC_BUDGET);
+    chunk_printf(st, "  \"heap\": { \"free\": %u, \"boot\": %u, \"low\": %u },\n", mem->heap_free, mem->heap_boot, mem->heap_low);
+  } else if (step == 1) {
+    mem = mem_get_stats();
+    chunk_printf(st, "  \"stack\": { \"size\": %u, \"used\": %u },\n", mem->stack_size, mem->stack_used);
+    chunk_printf(st, "  \"subsystems\": [\n");
+  } else if (st->last) {
+    return (false);
+  } else if (mem_get_use(step - 2, &use) == true) {
+    chunk_printf(st, "    %s{ \"name\": \"%s\", \"bytes\": %u, \"heap\": %s }\n",
+                 (step > 2 ? "," : ""), use.name, use.bytes, (use.heap ? "true" : "false"));
+  } else {
+    chunk_printf(st, "  ]\n}\n");
+    st->last = true;
+  }
+  return (true);
+}  // genMemory()
+
+void handleMemory(AsyncWebServerRequest *request) {
+  chunk_send(request, genMemory);
+}  // handleMemory()
+
+// flash traffic per call site (see bt_fsio.cpp), two steps per site
+bool genFsio(chunk_state *st, uint32_t step) {
+  const fsio_stats_t *io;
+  uint32_t up = millis() / 1000;
+
+  if (step == 0) {
+    chunk_printf(st, "{\n  \"uptime_s\": %u, \"erases\": %u, \"erases_per_day\": %u,\n  \"sites\": [\n",
+                 up, fsio_erases(), (up > 0 ? (uint32_t)(((uint64_t)fsio_erases() * 86400) / up) : 0));
+  } else if ((io = fsio_get_stats((step - 1) / 2)) == NULL) {
+    chunk_printf(st, "  ]\n}\n");
+    return (false);
+  } else if ((step & 1) != 0) {
+    chunk_printf(st, "    %s{ \"site\": \"%s\", \"opens\": %u, \"reads\": %u, \"bytes_read\": %u, ",
+                 (step > 1 ? "," : ""), fsio_site_name((step - 1) / 2), io->opens, io->reads, io->bytes_read);
+  } else {
+    chunk_printf(st, "\"writes\": %u, \"bytes_written\": %u, \"erases\": %u, \"ms\": %u }\n",
+                 io->writes, io->bytes_written, io->erases, io->us / 1000);
+  }
+  return (true);
+}  // genFsio()
+
+void handleFsio(AsyncWebServerRequest *request) {
+  chunk_send(request, genFsio);
+}  // handleFsio()
+
+// the messages still in the log ring (see bt_loglib.cpp), oldest first, one per step
+bool genLog(chunk_state *st, uint32_t step) {
+  char line[CHUNK_BUF_SIZE - 16];  // room for the time and level in front
+  uint32_t ms;
+  int8_t level;
+  size_t len;
+
+  if (step == 0) {
+    log_first(&st->log);
+    chunk_printf(st, "# level %d, %u messages lost since boot\n", log_level, log_lost());
+    return (true);
+  }
+  if (!log_next(&st->log, &ms, &level, line, sizeof(line))) { return (false); }
+  len = strlen(line);
+  if ((len > 0) && (line[len - 1] == '\n')) { line[len - 1] = '\0'; }
+  chunk_printf(st, "%10u %c %s\n", ms, ((level >= DBG_ERROR) && (level <= DBG_VERBOSE) ? "EWIDV"[level] : '?'), line);
+  return (true);
+}  // genLog()
+
+void handleLog(AsyncWebServerRequest *request) {
+  chunk_send_type(request, "text/plain; charset=utf-8", genLog);
+}  // handleLog()
+
 // This function is called when the netInfo service was requested.
 // ... added this to see if I could extend the built in functions ... worked (and useful)
-void handleNetInfo() {
-  String result;
-  long rssi = 0;
-
-  result += "{ NETWORK STATUS, \n";
-  result += "  {";
-    if(WiFi.status() == WL_CONNECTED) result += " \"status \": connected,\n";
-    else result += " \"status \": disconnected,\n";  // not sure how this will ever be sent
-    result += "    \"ip_address\":" + WiFi.localIP().toString() + ",\n";
-    result += "    \"WiFi RSSI\":" + String(WiFi.RSSI()) + ",\n";
-    result += "  }\n";
-  result += "}\n";
-
-  server.sendHeader("Cache-Control", "no-cache");
-  server.send(200, "text/javascript; charset=utf-8", result);
+bool genNetInfo(chunk_state *st, uint32_t step) {
+  switch (step) {
+    case 0:
+      chunk_printf(st, "{\n");
+      chunk_printf(st, "  \"status\": \"%s\",\n", (WiFi.status() == WL_CONNECTED ? "connected" : "disconnected"));  // not sure how disconnected will ever be sent
+      chunk_printf(st, "  \"ip_address\": \"%s\",\n", WiFi.localIP().toString().c_str());
+      chunk_printf(st, "  \"WiFi RSSI\": %d,\n", WiFi.RSSI());
+      break;
+    case 1: {
+      const neo_udp_stats_t *udp = neo_udp_get_stats();
+      chunk_printf(st, "  \"udp\": { \"rx\": %u, \"late\": %u, \"dropped\": %u, \"bad\": %u, \"frames\": %u },\n",
+                   udp->rx, udp->late, udp->dropped, udp->bad, udp->frames);
+      } break;
+    case 2: {
+      const wifi_stats_t *wifi = wifi_get_stats();
+      chunk_printf(st, "  \"wifi\": { \"source\": %d, \"channel\": %d, \"connects\": %u, \"fast\": %u, ",
+                   wifi->source, wifi->channel, wifi->connects, wifi->fast);
+      } break;
+    case 3: {
+      const wifi_stats_t *wifi = wifi_get_stats();
+      chunk_printf(st, "\"fast_fail\": %u, \"drops\": %u, \"rounds\": %u, \"last_ms\": %u, ",
+                   wifi->fast_fail, wifi->drops, wifi->rounds, wifi->last_ms);
+      } break;
+    case 4: {
+      const wifi_stats_t *wifi = wifi_get_stats();
+      chunk_printf(st, "\"min_ms\": %u, \"avg_ms\": %u, \"max_ms\": %u },\n",
+                   wifi->min_ms, (wifi->connects > 0 ? wifi->total_ms / wifi->connects : 0), wifi->max_ms);
+      } break;
+    case 5: {
+      const neo_sync_stats_t *sync = neo_sync_get_stats();
+      chunk_printf(st, "  \"sync\": { \"role\": %d, \"locked\": %s, \"offset_ms\": %d, \"skew_ppm\": %d, ",
+                   sync->role, (sync->locked ? "true" : "false"), (int)(sync->offset_us / 1000), (int)(sync->skew * 1e6f));
+      } break;
+    case 6: {
+      const neo_sync_stats_t *sync = neo_sync_get_stats();
+      chunk_printf(st, "\"err_us\": %d, \"beacons\": %u, \"steps\": %u }\n", sync->last_err_us, sync->beacons, sync->steps);
+      chunk_printf(st, "}\n");
+      } break;
+    default:
+      return (false);
+  }
+  return (true);
+}  // genNetInfo()
+
+void handleNetInfo(AsyncWebServerRequest *request) {
+  chunk_send(request, genNetInfo);
 }  // handleNetInfo()
 
+//
+// collect the body of a small POST (e.g. a button press) into a buffer that
+// hangs off the request.  the async server calls this as the body arrives and
+// frees request->_tempObject when the request is done.
+// bodies larger than max are not collected (the handler sees NULL).
+//
+void collectBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total, size_t max) {
+  if (total >= max) { return; }
+  if (index == 0) { request->_tempObject = malloc(total + 1); }
+  if (request->_tempObject != NULL) {
+    memcpy((uint8_t *)request->_tempObject + index, data, len);
+    if ((index + len) >= total) { ((char *)request->_tempObject)[total] = '\0'; }
+  }
+}
+
+#define BUTTON_BODY_MAX 128
+
+void handleButtonBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  collectBody(request, data, len, index, total, BUTTON_BODY_MAX);
+}
+
 //
 // handle button presses from the index.htm file
 // - all buttons on the default page call this same function based
@@ -349,164 +738,502 @@ void handleNetInfo() {
 // - the javascript in index.htm constructs and sends a json string ("sequence" : "value"),
 //   as the body of the POST,
 //   to identify the identity of the specific button being pressed.
+//   (the body was collected by handleButtonBody() before this is called)
 // - non-sequence, special purpose "value"'s are intercepted and processed
 //   by this function, otherwise the value is sent to neo_set_sequence()
 //   to do what the function name says
 // 
-void handleButton()  {
+void handleButton(AsyncWebServerRequest *request)  {
   int8_t neoerr = NEO_SUCCESS;
-  char buf[128];
-  char *file = NULL;
-  const char *seq, *filename;
-  JsonDocument jsonDoc;
+  const char *buf = (const char *)request->_tempObject;
+  JsonDocument jsonDoc(json_pool());
   DeserializationError err;
 
-  if(server.method() == HTTP_POST)  {
-    /*
-     * get the value of the button pressed
-     */
-    String body = server.arg("plain");
-    DEBUG_DEBUG("Button pressed: ");
-    body.toCharArray(buf, sizeof(buf));
-    DEBUG_DEBUG("return buffer <%s>\n", buf);
+  if(buf == NULL)  {
+    request->send(413, "text/plain", "handleButton(): missing or oversized body");
+    return;
+  }
 
+  DEBUG_DEBUG("Button pressed: ");
+  DEBUG_DEBUG("return buffer <%s>\n", buf);
+
+  /*
+   * parse the json to get to just the sequence label
+   */
+  err = deserializeJson(jsonDoc, buf);
+  if(err)  {
+    DEBUG_ERROR("ERROR: Deserialization of button failed: %s\n", err.f_str());
+    neoerr = NEO_DESERR;
+  }
+  else
+    neoerr = processButton(jsonDoc);
+
+  if(neoerr != NEO_SUCCESS)
+    request->send(404, "text/plain", "handleButton(): Couldn't process button press");
+  else  {
+    // Set the response header with "Connection: keep-alive" 
+    AsyncWebServerResponse *response = request->beginResponse(202, "text/plain", "handleButton(): queued");
+    response->addHeader("Connection", "keep-alive");
+    request->send(response);
+  }
+}
+
+// a sequence document posted to /api/play, waiting for loop() (see handlePlay())
+static char *play_pending = NULL;
+
+//
+// act on a parsed button press, {"sequence" : label, "file" : filename},
+// whether it came in as a POST to /api/button or over the websocket.
+// this runs in a server callback, so the press is only queued: with board
+// sync configured it's passed on to all of the boards and played a moment
+// later, otherwise on the next loop() (see neo_sync.cpp).
+// NOTE: this code is very sensitive to types of variables
+// used in extracting values after parsing.  
+// e.g. const char *seq; was specifically required to get the
+// jsonDoc["sequence"] to build, apparently due to the overloading
+// that's built into this function (i.e. adding the const specifier).
+//
+int8_t processButton(JsonDocument &jsonDoc)  {
+  int8_t neoerr = NEO_SUCCESS;
+  const char *seq;
+
+  DEBUG_DEBUG("json parsing successful, extracting value\n");
+  seq = jsonDoc["sequence"];
+  if(seq != NULL)  {
+    free(play_pending);  // the latest press wins over a posted sequence
+    play_pending = NULL;
+    neoerr = neo_sync_play(seq, jsonDoc["file"] | "");
+  }
+  else  {
+    neoerr = NEO_NOPLACE;
+    DEBUG_ERROR("ERROR: \"sequence\" not found in json data\n");
+  }
+  return(neoerr);
+}
+
+//
+// play the sequence labeled seq now (from loop(), via neo_sync_service())
+// (file is the sequence file the page sent with it, only needed for
+// files that aren't in the index yet)
+//
+int8_t playSequence(const char *seq, const char *file)  {
+  int8_t neoerr = NEO_SUCCESS;
+  const neo_lib_entry_t *entry;
+
+  DEBUG_INFO("Setting sequence to %s\n", seq);
+
+  /*
+   * was it the stop button
+   */
+  if(strcmp(seq, "STOP") == 0)
+    neo_cycle_stop();
+
+  /*
+   * if not STOP, see if it's in the sequence file index
+   * if so, load the file and set the sequence and strategy
+   */
+  else if((entry = neo_lib_find(seq)) != NULL)  {
+    if((neoerr = neo_load_sequence(entry->file)) != NEO_SUCCESS)
+      DEBUG_ERROR("ERROR: Error loading sequence file %s\n", entry->file);
+  }
+
+  /*
+   * the older USER-x buttons carry their file name with them
+   */
+  else if(((neo_is_user(seq)) == NEO_SUCCESS) && (file[0] != '\0'))  {
+    if((neoerr = neo_load_sequence(file)) != NEO_SUCCESS)
+      DEBUG_ERROR("ERROR: Error loading sequence file after proper detection\n");
+  }
+
+  /*
+   * if not STOP or USER-x, then attempt to set the sequence,
+   * assuming that it's a pre-defined button.
+   * strategies are hardcoded for built in sequences.
+   */
+  else  {
+    if((neoerr = neo_set_sequence(seq, "")) != NEO_SUCCESS)
+      DEBUG_ERROR("ERROR: Error setting sequence after proper detection\n");
+  }
+  return(neoerr);
+}
+
+//
+// play a sequence document posted in the body straight from RAM
+// (POST /api/play, same json as a sequence file).  nothing touches the
+// flash unless the document also has "save" : "/filename.json", in which
+// case it's written to that file as well (e.g. to keep it for a USER button).
+// decoding, playing and saving it is left to loop() (playService()):
+// the handler just takes the body over as the one pending document.
+//
+void handlePlayBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  collectBody(request, data, len, index, total, MAX_NEO_FILE);
+}
+
+void handlePlay(AsyncWebServerRequest *request)  {
+  char *buf = (char *)request->_tempObject;
+
+  if(buf == NULL)  {
+    request->send(413, "text/plain", "handlePlay(): missing or oversized body");
+    return;
+  }
+
+  free(play_pending);  // a newer document replaces one that hasn't been played yet
+  play_pending = buf;
+  request->_tempObject = NULL;  // so the server doesn't free it
+  request->send(202, "text/plain", "handlePlay(): queued");
+}
+
+void playService(void)  {
+  char *buf = play_pending;
+  JsonDocument saveDoc(json_pool()), filter(json_pool());
+  const char *fname;
+
+  if(buf == NULL)
+    return;
+  play_pending = NULL;
+
+  if(neo_play_json(buf, strlen(buf)) != NEO_SUCCESS)
+    DEBUG_ERROR("ERROR: playService: couldn't play the posted sequence\n");
+  else  {
     /*
-     * parse the json to get to just the sequence label
-     * NOTE: this code is very sensitive to types of variables
-     * used in extracting values after parsing.  
-     * e.g. const char *seq; was specifically required to get the
-     * jsonDoc["sequence"] to build, apparently due to the overloading
-     * that's built into this function (i.e. adding the const specifier).
+     * only pick the save name out of the document
      */
+    filter["save"] = true;
+    deserializeJson(saveDoc, buf, DeserializationOption::Filter(filter));
+    if(((fname = saveDoc["save"]) != NULL) && (saveSequence(fname, buf) == false))
+      DEBUG_ERROR("ERROR: playService: playing, but couldn't save %s\n", fname);
+  }
+  free(buf);
+  wsPushState(NULL);  // the label may have changed without the slot changing
+}
 
-    err = deserializeJson(jsonDoc, buf);
-    if(err)  {
-      DEBUG_ERROR("ERROR: Deserialization of button failed: %s\n", err.f_str());
-      neoerr = NEO_DESERR;
-    }
+//
+// write a sequence document to fname, via a temp file so that a failed
+// write leaves any existing file as it was
+//
+bool saveSequence(const char *fname, const char *buf)  {
+  size_t len = strlen(buf);
+  String tName = String(fname) + "~";
+  File fd;
+
+  if(fname[0] != '/')  {
+    DEBUG_ERROR("ERROR: saveSequence: %s must start with /\n", fname);
+    return(false);
+  }
+  if(!(fd = fsio_open(FSIO_SAVE, tName.c_str(), "w")))
+    return(false);
+  if(fsio_write(FSIO_SAVE, fd, (const uint8_t *)buf, len) != len)  {
+    fsio_close(FSIO_SAVE, fd);
+    LittleFS.remove(tName);
+    return(false);
+  }
+  fsio_close(FSIO_SAVE, fd);
+  DEBUG_INFO("saveSequence: saved %u bytes to %s\n", len, fname);
+  if(!LittleFS.rename(tName, fname))
+    return(false);
+  neo_lib_invalidate();  // it may be a new button
+  return(true);
+}
+
+// ===== WebSocket control channel =====
+//
+// the button page keeps a websocket open to /ws so that a button press is
+// one small frame on an already open connection rather than a new TCP
+// connection and http request (see the 5-10 second first press notes above).
+// commands (json text frames):
+//   {"cmd" : "play", "sequence" : label, "file" : filename}  same as /api/button
+//   {"cmd" : "stop"}
+//   {"cmd" : "brightness", "value" : 0-255}
+//   {"cmd" : "state"}
+// whenever the sequence or play state changes, every connected page is sent
+//   {"type" : "state", "sequence" : label, "playing" : true/false}
+// so that all of the players' phones show the same thing.
+// like the http handlers, commands are only queued here and carried out
+// from loop(), which then pushes the new state.
+AsyncWebSocket ws("/ws");
+static volatile int16_t ws_brightness = -1;  // brightness command waiting for loop(), -1 for none
+
+#define WS_CLEANUP_INTERVAL 1000  // mS between dropping stale websocket clients
+
+// push the current sequence and state to one client, or to all if client is NULL
+// (built with ArduinoJson, labels come from uploaded documents and may need escaping)
+void wsPushState(AsyncWebSocketClient *client)  {
+  char label[MAX_NEO_LABEL];
+  JsonDocument jsonDoc(json_pool());
+  String msg;
+  int8_t idx = neo_get_playing(label);
+
+  jsonDoc["type"] = "state";
+  jsonDoc["sequence"] = label;  // copied into the document, label is on the stack
+  jsonDoc["playing"] = (idx >= 0);
+  serializeJson(jsonDoc, msg);
+  if(client != NULL)
+    client->text(msg);
+  else
+    ws.textAll(msg);
+}
+
+void wsCommand(AsyncWebSocketClient *client, uint8_t *data, size_t len)  {
+  int8_t neoerr = NEO_SUCCESS;
+  JsonDocument jsonDoc(json_pool());
+  DeserializationError err;
+  const char *cmd;
+
+  err = deserializeJson(jsonDoc, (const char *)data, len);
+  if(err)  {
+    DEBUG_ERROR("ERROR: Deserialization of websocket command failed: %s\n", err.f_str());
+    neoerr = NEO_DESERR;
+  }
+  else  {
+    cmd = jsonDoc["cmd"] | "play";
+    if(strcmp(cmd, "play") == 0)
+      neoerr = processButton(jsonDoc);
+    else if(strcmp(cmd, "stop") == 0)
+      neoerr = neo_sync_play("STOP", "");
+    else if(strcmp(cmd, "brightness") == 0)
+      ws_brightness = constrain((int)(jsonDoc["value"] | 255), 0, 255);
+    else if(strcmp(cmd, "state") == 0)
+      wsPushState(client);
     else  {
-      DEBUG_DEBUG("json parsing successful, extracting value\n");
-      seq = jsonDoc["sequence"];
+      DEBUG_ERROR("ERROR: unknown websocket command %s\n", cmd);
+      neoerr = NEO_SEQ_ERR;
+    }
+  }
+
+  if(neoerr != NEO_SUCCESS)
+    client->text("{\"type\":\"error\",\"msg\":\"Couldn't process command\"}");
+}
+
+void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)  {
+  AwsFrameInfo *info;
+
+  switch(type)  {
+    case WS_EVT_CONNECT:
+      DEBUG_INFO("websocket client %u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+      wsPushState(client);
+      break;
+
+    case WS_EVT_DISCONNECT:
+      DEBUG_INFO("websocket client %u disconnected\n", client->id());
+      break;
+
+    case WS_EVT_DATA:
       /*
-       * process the button that was pressed based on the seq string
+       * commands are small: only single, complete text frames are accepted
        */
-      if(seq != NULL)  {
-        DEBUG_INFO("Setting sequence to %s\n", seq);
-
-        /*
-         * was it the stop button
-         */
-        if(strcmp(seq, "STOP") == 0)
-          neo_cycle_stop();
-
-        /*
-         * if not STOP, see if it was a USER defined sequence
-         * if so, load the file and set the sequence and strategy
-         */
-        else if((neo_is_user(seq)) == NEO_SUCCESS)  {
-          if((neoerr = neo_load_sequence(jsonDoc["file"])) != NEO_SUCCESS)
-            DEBUG_ERROR("ERROR: Error loading sequence file after proper detection\n");
-        }
+      info = (AwsFrameInfo *)arg;
+      if(info->final && (info->index == 0) && (info->len == len) && (info->opcode == WS_TEXT))
+        wsCommand(client, data, len);
+      break;
 
-        /*
-         * if not STOP or USER-x, then attempt to set the sequence,
-         * assuming that it's a pre-defined button.
-         * strategies are hardcoded for built in sequences.
-         */
-        else  {
-          if((neoerr = neo_set_sequence(seq, "")) != NEO_SUCCESS)
-            DEBUG_ERROR("ERROR: Error setting sequence after proper detection\n");
-        }
-      }
-      else  {
-        neoerr = NEO_NOPLACE;
-        DEBUG_ERROR("ERROR: \"sequence\" not found in json data\n");
-      }
-    }
-    if(neoerr != NEO_SUCCESS)
-      server.send(404, "text/plain", "handleButton(): Couldn't process button press");
-    else  {
-      // Set the response header with "Connection: keep-alive" 
-      server.sendHeader("Connection", "keep-alive");
-      server.send(201, "text/plain", "handleButton(): success");
-    }
+    default:
+      break;
   }
-  else
-    server.send(405, "text/plain", "handleButton(): Method Not Allowed");
 }
 
 // ===== Request Handler class used to answer more complex requests =====
 
+// uploads are written to name~ and renamed over name only once the whole file
+// has arrived, so a failed upload leaves the old file alone.
+// the data is gathered into whole flash pages before it's written (the tcp
+// pieces are ~1.4k and land anywhere in a page) and while the upload
+// matches the file that's already there nothing is written at all;
+// uploading the same sequence again doesn't touch the flash.
+#define UPLOAD_PAGE_SIZE 256  // LittleFS program (page) size on the ESP8266
+#define UPLOAD_TMP_SUFFIX "~"
+
+struct upload_state {
+  bool same;            // everything so far matches the existing file
+  bool failed;          // a write failed, keep the old file
+  uint16_t fill;        // bytes in buf
+  uint32_t writes;      // page writes to the temp file
+  uint32_t start;       // millis() at the first piece
+  uint8_t buf[UPLOAD_PAGE_SIZE];
+};
+
 // The FileServerHandler is registered to the web server to support DELETE and UPLOAD of files into the filesystem.
-class FileServerHandler : public RequestHandler {
+class FileServerHandler : public AsyncWebHandler {
 public:
   // @brief Construct a new File Server Handler object
-  // @param fs The file system to be used.
-  // @param path Path to the root folder in the file system that is used for serving static data down and upload.
-  // @param cache_header Cache Header to be used in replies.
   FileServerHandler() {
     DEBUG_INFO("FileServerHandler is registered\n");
   }
 
 
   // @brief check incoming request. Can handle POST for uploads and DELETE.
-  // @param requestMethod method of the http request line.
-  // @param requestUri request ressource from the http request line.
+  // @param request the incoming request (method and url).
   // @return true when method can be handled.
-  bool canHandle(HTTPMethod requestMethod, const String UNUSED &_uri) override {
-    return ((requestMethod == HTTP_POST) || (requestMethod == HTTP_DELETE));
+  bool canHandle(AsyncWebServerRequest *request) override {
+    return ((request->method() == HTTP_POST) || (request->method() == HTTP_DELETE));
   }  // canHandle()
 
 
-  bool canUpload(const String &uri) override {
-    // only allow upload on root fs level.
-    return (uri == "/");
-  }  // canUpload()
+  // uploads need the body to be parsed, so this isn't a trivial handler
+  bool isRequestHandlerTrivial() override {
+    return (false);
+  }
 
 
-  bool handle(ESP8266WebServer &server, HTTPMethod requestMethod, const String &requestUri) override {
+  void handleRequest(AsyncWebServerRequest *request) override {
     // ensure that filename starts with '/'
-    String fName = requestUri;
+    String fName = request->url();
     if (!fName.startsWith("/")) { fName = "/" + fName; }
 
-    if (requestMethod == HTTP_POST) {
+    if (request->method() == HTTP_POST) {
       // all done in upload. no other forms.
+      upload_state *st = (upload_state *)request->_tempObject;
+      if ((st != NULL) && st->failed) {
+        request->send(500, "text/plain", "upload failed, the old file was kept");
+        return;
+      }
 
-    } else if (requestMethod == HTTP_DELETE) {
+    } else if (request->method() == HTTP_DELETE) {
       if (LittleFS.exists(fName)) { 
         LittleFS.remove(fName);
         DEBUG_INFO("handle: %s deleted successfully\n", fName.c_str());
+        neo_lib_invalidate();
+#ifdef WEB_BUNDLE
+        webBundleInvalidate();  // the bundled copy may be back in play
+#endif
       }
     }  // if
 
-    server.send(200);  // all done.
-    return (true);
-  }  // handle()
+    request->send(200);  // all done.
+  }  // handleRequest()
 
 
-  // uploading process
-  void upload(ESP8266WebServer UNUSED &server, const String UNUSED &_requestUri, HTTPUpload &upload) override {
+  // uploading process ... called for each piece of the file as it arrives
+  void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) override {
+    upload_state *st;
+
+    // only allow upload on root fs level.
+    if (request->url() != "/") { return; }
+
     // ensure that filename starts with '/'
-    String fName = upload.filename;
+    String fName = filename;
     if (!fName.startsWith("/")) { fName = "/" + fName; }
+    String tName = fName + UPLOAD_TMP_SUFFIX;
 
-    if (upload.status == UPLOAD_FILE_START) {
-      // Open the file
-      if (LittleFS.exists(fName)) { LittleFS.remove(fName); }  // if
-      _fsUploadFile = LittleFS.open(fName, "w");
+    if (index == 0) {
+      if ((request->_tempObject = malloc(sizeof(upload_state))) == NULL) {
+        DEBUG_ERROR("ERROR: no memory for upload of %s\n", fName.c_str());
+        return;
+      }
+      st = (upload_state *)request->_tempObject;
+      st->same = LittleFS.exists(fName);
+      st->failed = false;
+      st->fill = 0;
+      st->writes = 0;
+      st->start = millis();
+      if (LittleFS.exists(tName)) { LittleFS.remove(tName); }  // left over from an aborted upload
+      if (!st->same) { startTemp(request, fName, tName, 0, st); }  // a new file, nothing to compare against
+    }
+    if ((st = (upload_state *)request->_tempObject) == NULL) { return; }
 
-    } else if (upload.status == UPLOAD_FILE_WRITE) {
-      // Write received bytes
-      if (_fsUploadFile) { _fsUploadFile.write(upload.buf, upload.currentSize); }
+    if (st->same && !matchesOld(fName, index, data, len, st->buf)) {
+      // first difference: from here on it's a real upload
+      st->same = false;
+      startTemp(request, fName, tName, index, st);
+    }
+    if (!st->same) { writeTemp(request, data, len, st); }
+
+    if (final) {
+      size_t total = index + len;
+
+      if (st->same) {
+        File old = fsio_open(FSIO_UPLOAD, fName.c_str(), "r");
+        bool longer = (old.size() != total);
+        fsio_close(FSIO_UPLOAD, old);
+        if (!longer) {
+          DEBUG_INFO("upload: %s unchanged, %u bytes, nothing written\n", fName.c_str(), total);
+          return;
+        }
+        // the upload is the start of the old file, it still has to be written
+        st->same = false;
+        startTemp(request, fName, tName, total, st);
+      }
 
-    } else if (upload.status == UPLOAD_FILE_END) {
-      // Close the file
-      if (_fsUploadFile) { _fsUploadFile.close(); }
+      // write out the last partial page and swap the new file in
+      if (st->fill > 0) { flushTemp(request, st); }
+      if (request->_tempFile) { fsio_close(FSIO_UPLOAD, request->_tempFile); }
+      if (st->failed || !LittleFS.rename(tName, fName)) {  // LittleFS rename replaces fName atomically
+        st->failed = true;
+        LittleFS.remove(tName);
+        DEBUG_ERROR("ERROR: upload of %s failed, old file kept\n", fName.c_str());
+      } else {
+        DEBUG_INFO("upload: %s %u bytes in %u mS, %u page writes\n", fName.c_str(), total,
+                   (unsigned)(millis() - st->start), (unsigned)st->writes);
+        neo_lib_invalidate();
+      }
+#ifdef WEB_BUNDLE
+      webBundleInvalidate();  // the upload may override a bundled file
+#endif
     }  // if
-  }    // upload()
+  }    // handleUpload()
+
+private:
+  // does data match the existing file at offset index?
+  // (uses scratch, the page buffer, which is empty while nothing is being written)
+  static bool matchesOld(const String &fName, size_t index, const uint8_t *data, size_t len, uint8_t *scratch) {
+    bool match = true;
+    File old = fsio_open(FSIO_UPLOAD, fName.c_str(), "r");
+
+    if (!old || !old.seek(index)) { return (false); }
+    for (size_t done = 0; match && (done < len); ) {
+      size_t n = min(len - done, (size_t)UPLOAD_PAGE_SIZE);
+      match = (fsio_read(FSIO_UPLOAD, old, scratch, n) == n) && (memcmp(scratch, data + done, n) == 0);
+      done += n;
+    }
+    fsio_close(FSIO_UPLOAD, old);
+    return (match);
+  }
+
+  // open the temp file and copy in the first count bytes of the old file,
+  // which matched what has been uploaded up to now
+  // (a page at a time through st->buf, which is empty at this point)
+  static void startTemp(AsyncWebServerRequest *request, const String &fName, const String &tName, size_t count, upload_state *st) {
+    File old;
+
+    request->_tempFile = fsio_open(FSIO_UPLOAD, tName.c_str(), "w");
+    if (!request->_tempFile) {
+      st->failed = true;
+      return;
+    }
+    if (count > 0) {
+      old = fsio_open(FSIO_UPLOAD, fName.c_str(), "r");
+      for (size_t done = 0; done < count; ) {
+        size_t n = min(count - done, (size_t)UPLOAD_PAGE_SIZE);
+        if (fsio_read(FSIO_UPLOAD, old, st->buf, n) != n) {
+          st->failed = true;
+          break;
+        }
+        st->fill = n;
+        if (n == UPLOAD_PAGE_SIZE) { flushTemp(request, st); }  // a partial last page is topped up by writeTemp()
+        done += n;
+      }
+      old.close();  // not fsio_close(), that would count the temp file's blocks before it is done
+    }
+  }
 
-protected:
-  File _fsUploadFile;
+  // gather data into the page buffer, writing whole pages out as they fill
+  static void writeTemp(AsyncWebServerRequest *request, const uint8_t *data, size_t len, upload_state *st) {
+    while (len > 0) {
+      size_t n = min(len, (size_t)(UPLOAD_PAGE_SIZE - st->fill));
+      memcpy(st->buf + st->fill, data, n);
+      st->fill += n;
+      data += n;
+      len -= n;
+      if (st->fill == UPLOAD_PAGE_SIZE) { flushTemp(request, st); }
+    }
+  }
+
+  static void flushTemp(AsyncWebServerRequest *request, upload_state *st) {
+    if (!st->failed && request->_tempFile && (fsio_write(FSIO_UPLOAD, request->_tempFile, st->buf, st->fill) != st->fill)) {
+      st->failed = true;
+    }
+    st->writes++;
+    st->fill = 0;
+  }
 };
 
 // ^^^^^^^^^^^^^^^^^^^ END OF SERVER SETUP AND CALLBACKS ^^^^^^^^^^^^^^^^^^^^^^^^
@@ -532,206 +1259,52 @@ void IRAM_ATTR neoTimerHandler(void) {
  */
 
 /*
- * little helper to wait for the wifi connection
+ * boot runs as a state machine from loop() so that the strand comes up
+ * straight out of setup() (a few tens of mS after power-on) and the slow
+ * parts happen in the background while the default sequence plays:
+ * - the serial window to change the eeprom settings (BOOT_PROMPT_TICKS)
+ * - the physical config button (SoftAP configuration)
+ * - WiFi connection (see bt_wifilib.cpp)
+ * - OTA, NTP and the web server, once WiFi is up (or has given up)
+ * - the green/red WiFi status blinks, if nothing is playing
  */
-wl_status_t l_wifi_wait(void)  {
-  int8_t tries = -1;
-
-  DEBUG_INFO("Connecting to WiFi...\n");
-  if((tries = atoi(pmon_config->wifitries)) < 0)
-    tries = 10;  // default to 10 ... seems to take about 6 on my local network
-  while ((WiFi.status() != WL_CONNECTED) && (tries > 0)) {
-    DEBUG_INFO("%d ", tries);
-    delay(500);
-    tries--;
-  }
-  DEBUG_INFO("\n");
+#define BOOT_TICK           500   // mS per prompt/WiFi/blink tick
+#define BOOT_PROMPT_TICKS   6     // ticks to press a key for the settings prompt
+#define BOOT_PIN_SETTLE     1000  // mS for the config button pull-up to settle
+#define BOOT_BLINKS         6     // on/off half cycles of the WiFi status blinks
+
+typedef enum {
+  BOOT_WIFI_BEGIN = 0,
+  BOOT_WIFI_WAIT,
+  BOOT_SERVICES,
+  BOOT_BLINK,
+  BOOT_DONE,
+} boot_state_t;
+
+struct boot_status  {
+  boot_state_t state;
+  uint32_t t_state;      // millis() of the last tick in this state
+  int8_t prompt_ticks;   // ticks left in the serial settings window
+  uint32_t t_prompt;
+  uint32_t t_pin;        // millis() when the config button pin was set up
+  bool pin_checked;
+  int8_t blinks;
+  uint32_t first_frame;  // mS after power-on of the first frame
+  uint32_t web_ready;    // mS after power-on that the web server started
+};
+struct boot_status boot = {BOOT_WIFI_BEGIN, 0, BOOT_PROMPT_TICKS, 0, 0, false, 0, 0, 0};
 
-  if(WiFi.status() == WL_CONNECTED)
-    DEBUG_INFO("connected at %s\n", WiFi.localIP().toString().c_str());
-  else
-    DEBUG_ERROR("ERROR: Error connecting WiFi\n");
-  
-  return(WiFi.status());
+void boot_next(boot_state_t state)  {
+  boot.state = state;
+  boot.t_state = millis();
 }
 
-
-void setup(void) {
-  delay(3000);  // wait for serial monitor to start completely.
-
-  // Use Serial port for some trace information from the example
-  Serial.begin(115200);
-  //Serial.setDebugOutput(false);  // TODO: what is this ???
-
-  /*
-   * set the debug message level:
-   * DBG_NONE - no debug output is shown
-   * DBG_ERROR - critical errors
-   * DBG_WARNING - non-critical errors
-   * DBG_INFO - information
-   * DBG_DEBUG - more information
-   * DBG_VERBOSE - most information
-   * NOTE: these map to integers -1 to 4 ... a little hacky, but
-   *       use the epprom value in the same way
-   */
-  Debug.setDebugLevel(DBG_VERBOSE);  // bootstrap here; set when eeprom is connected
-  Debug.newlineOff();
-  int debug_level = DBG_VERBOSE;  // for eeprom read
-
-
-  /*
-   * initialize the EEPROM for basic bootstrapping of application
-   * (e.g. wifi credentials)
-   *
-   * NOTE: don't use the Arduino debug library for this part
-   */
-  eeprom_begin();  // instantiate the eeprom class
-
-  Serial.println();
-  Serial.println(EEPROM_INTRO_MSG);
-  Serial.println();
-  Serial.println("Press any key to change settings");
-
-  int8_t tries = 6;
-  bool out = false;
-  char inChar = '\0';
-  while((out == false) && (tries > 0))  {
-    Serial.print(tries);Serial.print(" . ");
-  // check for incoming serial data:
-    if (Serial.available() > 0) {
-      // read incoming serial data:
-      inChar = Serial.read();
-      out = true;
-    }
-    delay(500);
-    tries--;
-  }
-  Serial.println();
-
-  /*
-   * prompt the user for input if the out bool was set above
-   * (if not, this function just loads the current contents of the eeprom)
-   */
-  eeprom_user_input(out);
-
-
-  /*
-   * mount and/or reformat the littleFS
-   * wait to do this until after eeprom work so that
-   * we know whether to format the fs.
-   */
-  FSInfo fs_info;
-
-  if(strcmp(pmon_config->reformat, "true") == 0)  {
-    DEBUG_INFO("Formatting the filesystem...\n");
-    if (!LittleFS.format())
-      DEBUG_ERROR("ERROR: Could not format the filesystem...\n");
-    else
-      DEBUG_INFO("Format successful\n");
-  }
-  delay(500);
-  DEBUG_INFO("Mounting the filesystem...\n");
-  if (!LittleFS.begin())
-    DEBUG_ERROR("ERROR: Could not mount the filesystem...\n");
-  else  {
-    LittleFS.info(fs_info);
-    DEBUG_INFO("Mount successful\n");
-    DEBUG_INFO("fsTotalBytes: %d\n", fs_info.totalBytes);
-    DEBUG_INFO("fsUsedBytes: %d\n", fs_info.usedBytes);
-  }
-  delay(500);
-
-  /*
-   * if the config physical button was pressed on power-up,
-   * instantiate and start the local soft AP to facilitate configuration
-   * from the captive page.  The esp is reset when this function exits.
-   */
-  pinMode(PIN_CONFIG, INPUT_PULLUP);
-  delay(1000);  // seems to be required to set it get to true before reading
-  Serial.println("Press config physical button to start configuration SoftAP");
-  if(digitalRead(PIN_CONFIG) == 0)
-    configSoftAP();
-
-  /*
-   * once all of the eeprom setup is done,
-   * set the debug level (see above for other comments)
-   */
-  debug_level = atoi(pmon_config->debug_level);
-  if(debug_level < -1) debug_level = DBG_NONE;
-  if(debug_level > 4)  debug_level = DBG_VERBOSE;
-  Debug.setDebugLevel(debug_level);
-  DEBUG_INFO("Debug level set to %d\n", Debug.getDebugLevel());
-
+/*
+ * everything that needs the network: OTA, NTP and the web server
+ */
+void startServices(void)  {
   DEBUG_INFO("Starting WebServer ...\n");
 
-
-
-  /*
-   * setup wifi to use a fixed IP address
-   * attempt to convert the ip address from the eeprom, and
-   * if that fails load a default address
-   */
-  uint8_t ip[4]; // ip address as octets
-
-  /*
-   * if eeprom config indicates that DHCP is disabled,
-   * set the fixed ip address
-   */
-  DEBUG_INFO("DHCP Enable = <%s>\n", pmon_config->dhcp_enable);
-  if(strcmp(pmon_config->dhcp_enable, "false") == 0)  {
-    DEBUG_INFO("... setting fixed address\n");
-    if(eeprom_convert_ip(pmon_config->ipaddr, ip) != 0)  {
-      DEBUG_ERROR("ERROR: Failed to convert eeprom IP address value ... loading default\n");
-      ip[0] = 192; ip[1] = 168; ip[2] = 1; ip[3] = 37;
-    }
-    const byte gateway[] = {192, 168, 1, 1}; // Gateway address
-    const byte subnet[] = {255, 255, 255, 0}; // Subnet mask
-    WiFi.config(ip, gateway, subnet); // Set static IP ... DZ added this
-  }
-
-  /*
-   * start WiFI ... DHCP by default, unless above is executed
-   */
-  WiFi.mode(WIFI_STA);
-
-  /*
-   * allow to address the device by the given name e.g. http://webserver
-   * saw a note in the reference manual that this had to happen before the WIFI.begin()
-   * doesn't seem to matter, but I caved to conventional wisdom.
-   */
-  WiFi.setHostname(HOSTNAME);
-
-  /*
-   * attempt these three cases to connect to WiFi:
-   *
-   * case 1:
-   *   if the wifi credentials were set in eeprom, attempt to use them.
-   * case 2:
-   *   attempt to connect to using the last good wifi credentials
-   *   that the esp stores in non-volatile memory
-   * case 3:
-   *   use the credentials set in secrets.h as the fallback
-   */
-  wl_status_t wifi_status = WL_DISCONNECTED;
-  if((strlen(pmon_config->wlan_ssid) > 0) && (strlen(pmon_config->wlan_pass) > 0))  {
-    DEBUG_INFO("Wifi.begin() is using eeprom values, ssid = %s\n", pmon_config->wlan_ssid);
-    WiFi.begin(pmon_config->wlan_ssid, pmon_config->wlan_pass);
-    wifi_status = l_wifi_wait();
-  }
-
-  if (wifi_status != WL_CONNECTED) {
-    DEBUG_WARNING("WARNING: Wifi.begin() is using the last known wifi (stored in nonvolatile memory)\n");
-    WiFi.begin();
-    wifi_status = l_wifi_wait();
-  }
-
-  if(wifi_status != WL_CONNECTED) {
-    DEBUG_WARNING("WARNING: Wifi.begin() is using fallback values from secrets.h, ssid = %s\n", ssid);
-    WiFi.begin(ssid, passPhrase);
-    l_wifi_wait();
-  }
-
-
   /*
   * OTA callbacks (from ArduinoOTA example)
   */
@@ -793,8 +1366,8 @@ void setup(void) {
   DEBUG_INFO("Register service handlers...\n");
 
   // serve a built-in htm page
-  server.on("/$upload.htm", []() {
-    server.send(200, "text/html", FPSTR(uploadContent));
+  server.on("/$upload.htm", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send_P(200, "text/html", uploadContent);
   });
 
   /*
@@ -807,8 +1380,8 @@ void setup(void) {
    * if one types something in the address line of a browser)
    * (see extensive comments in builtinfiles.h)
    */
-  server.on("/$delete", HTTP_GET, []() {
-      server.send(200, "text/html", FPSTR(deleteContent));
+  server.on("/$delete", HTTP_GET, [](AsyncWebServerRequest *request) {
+      request->send_P(200, "text/html", deleteContent);
   });
 
   // register a redirect handler when only domain name is given.
@@ -823,56 +1396,241 @@ void setup(void) {
   //
   server.on("/$list", HTTP_GET, handleListFiles);
   server.on("/$sysinfo", HTTP_GET, handleSysInfo);
+  server.on("/$memory", HTTP_GET, handleMemory);
+  server.on("/$fsio", HTTP_GET, handleFsio);
+  server.on("/$log", HTTP_GET, handleLog);
   server.on("/$netinfo", HTTP_GET, handleNetInfo);
-  server.on("/api/button", HTTP_POST, handleButton);
+  server.on("/api/sequences", HTTP_GET, handleSequences);
+  server.on("/api/button", HTTP_POST, handleButton, NULL, handleButtonBody);
+  server.on("/api/play", HTTP_POST, handlePlay, NULL, handlePlayBody);
+
+  // websocket for button presses and pushing the play state to the pages
+  ws.onEvent(onWsEvent);
+  server.addHandler(&ws);
 
   // UPLOAD and DELETE of files in the file system using a request handler.
   server.addHandler(new FileServerHandler());
 
-  // enable CORS header in webserver results
-  server.enableCORS(true);
+#ifdef WEB_BUNDLE
+  // pages built into the firmware, ahead of the file system
+  webBundleScan();
+  server.addHandler(new WebBundleHandler());
+#endif
 
-  // enable ETAG header in webserver results from serveStatic handler
-  server.enableETag(true);
+  // enable CORS header in webserver results
+  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
 
   // serve all static files
+  // (the async static handler sends the file in slices from the TCP callbacks)
+  // if name.gz exists it is sent instead of name with Content-Encoding: gzip,
+  // so upload the output of tools/pack_webpages.sh rather than webpages/.
+  // the background and the font never change, so the browser is told to keep
+  // them and they're only read out of flash on the first visit.  the pages,
+  // script and css are left to revalidate so that uploads show up right away.
+  // (the more specific handlers have to be added before the catch-all)
+  server.serveStatic("/background.png", LittleFS, "/background.png").setCacheControl(STATIC_IMMUTABLE);
+  server.serveStatic("/BlackOpsOne-subset.woff2", LittleFS, "/BlackOpsOne-subset.woff2").setCacheControl(STATIC_IMMUTABLE);
   server.serveStatic("/", LittleFS, "/");
 
   // handle cases when file is not found
-  server.onNotFound([]() {
+  server.onNotFound([](AsyncWebServerRequest *request) {
     // standard not found in browser.
-    server.send(404, "text/html", FPSTR(notFoundContent));
+    request->send_P(404, "text/html", notFoundContent);
   });
 
   server.begin();
   DEBUG_INFO("hostname=%s\n", WiFi.getHostname());
 
-  // initialize neopixel strip
-  DEBUG_INFO("Initialize neopixel strip with %d pixels...\n", atoi(pmon_config->neocount));
-  if(atoi(pmon_config->neocount) > 0)
-    neo_init(atoi(pmon_config->neocount), NEO_PIN, NEO_TYPE);
-  else
-    neo_init(NEO_NUMPIXELS, NEO_PIN, NEO_TYPE);
+  // listen for pixel streams (DDP, E1.31) from a pc light show
+  neo_udp_begin(pconfig->neotype);
 
-  DEBUG_INFO("Setting gamma correction to %s\n", pmon_config->neogamma);
-  if(strcmp(pmon_config->neogamma, "true") == 0)
-    neo_set_gamma_color(true);
-  else
-    neo_set_gamma_color(false);
+  // lead, follow or ignore the other boards' clock
+  DEBUG_INFO("Board sync role is %s\n", pmon_config->syncrole);
+  neo_sync_begin(neo_sync_role(pmon_config->syncrole), playSequence);
+}
+
+/*
+ * the serial settings window: if a key is pressed in the first
+ * BOOT_PROMPT_TICKS ticks, prompt for the eeprom settings and
+ * reboot to use them (NOTE: the prompt is blocking, the strand
+ * holds its last frame until the reboot)
+ */
+void boot_prompt(void)  {
+  if((boot.prompt_ticks <= 0) || ((millis() - boot.t_prompt) < BOOT_TICK))
+    return;
+  boot.t_prompt = millis();
+
+  // check for incoming serial data:
+  if (Serial.available() > 0) {
+    Serial.read();
+    log_flush();  // so the messages don't land in the middle of the prompts
+    Serial.println();
+    eeprom_user_input(true);
+    Serial.println("Rebooting to use the new settings ...");
+    delay(500);
+    ESP.restart();
+  }
+  Serial.print(boot.prompt_ticks);Serial.print(" . ");
+  if(--boot.prompt_ticks == 0)
+    Serial.println();
+}
+
+/*
+ * if the config physical button is held at power-up,
+ * instantiate and start the local soft AP to facilitate configuration
+ * from the captive page.  The esp is reset when configSoftAP() exits.
+ */
+void boot_config_pin(void)  {
+  if((boot.pin_checked == true) || ((millis() - boot.t_pin) < BOOT_PIN_SETTLE))
+    return;
+  boot.pin_checked = true;
+
+  if(digitalRead(PIN_CONFIG) == 0)  {
+    WiFi.disconnect(true);  // drop the station connection that's under way
+    configSoftAP();
+  }
+}
+
+void boot_service(void)  {
+  boot_prompt();
+  boot_config_pin();
+
+  switch(boot.state)  {
+    /*
+     * connect with (in order) a directed connect to the last good access
+     * point, the eeprom credentials, the last good credentials that the esp
+     * stores in non-volatile memory and the ones in secrets.h.
+     * the web server is started once connected or all of those failed,
+     * bt_wifilib keeps trying (and reconnects after a drop) from loop().
+     */
+    case BOOT_WIFI_BEGIN:
+      wifi_begin(pmon_config->wlan_ssid, pmon_config->wlan_pass, ssid, passPhrase,
+                 pconfig->wifitries, pconfig->dhcp_enable);
+      boot_next(BOOT_WIFI_WAIT);
+      break;
+
+    case BOOT_WIFI_WAIT:
+      if(wifi_tried_all() == true)
+        boot_next(BOOT_SERVICES);
+      break;
+
+    case BOOT_SERVICES:
+      startServices();
+      boot.web_ready = millis();
+      DEBUG_INFO("Boot: web server ready at %u mS\n", (unsigned)boot.web_ready);
+      mem_print();
+      boot.blinks = BOOT_BLINKS;
+      boot_next(BOOT_BLINK);
+      break;
+
+    /*
+     * give a visual indicator of WiFi connection status:
+     * three green (connected) or red blinks, unless the
+     * default sequence (or anything else) has the strand
+     */
+    case BOOT_BLINK:
+      if((seq_index >= 0) || (boot.blinks <= 0))
+        boot_next(BOOT_DONE);
+      else if((millis() - boot.t_state) >= BOOT_TICK)  {
+        boot.t_state = millis();
+        if((boot.blinks-- & 1) != 0)
+          neo_fill(0, 0, 0);
+        else if(WiFi.status() == WL_CONNECTED)
+          neo_fill(0, 128, 0);
+        else
+          neo_fill(128, 0, 0);
+      }
+      break;
+
+    case BOOT_DONE:
+    default:
+      break;
+  }
+}
+
+
+void setup(void) {
+  // Use Serial port for some trace information from the example
+  Serial.begin(115200);
+  //Serial.setDebugOutput(false);  // TODO: what is this ???
+  mem_begin();  // free heap before anything is allocated
 
   /*
-   * give a visual indicator of WiFi connection status
+   * set the debug message level:
+   * DBG_NONE - no debug output is shown
+   * DBG_ERROR - critical errors
+   * DBG_WARNING - non-critical errors
+   * DBG_INFO - information
+   * DBG_DEBUG - more information
+   * DBG_VERBOSE - most information
+   * NOTE: these map to integers -1 to 4 ... a little hacky, but
+   *       use the epprom value in the same way
    */
-  if(WiFi.status() == WL_CONNECTED)
-    neo_n_blinks(0, 128, 0, 3, 500);  // three green blinks ... NOTE: blocking function
+  log_set_level(DBG_VERBOSE);  // bootstrap here; set when eeprom is connected
+  Debug.newlineOff();
+
+  /*
+   * initialize the EEPROM for basic bootstrapping of application
+   * (e.g. wifi credentials) and load the current contents.
+   * the chance to change them is given by boot_prompt() from loop().
+   *
+   * NOTE: don't use the Arduino debug library for this part
+   */
+  eeprom_begin();  // instantiate the eeprom class
+
+  Serial.println();
+  Serial.println(EEPROM_INTRO_MSG);
+  Serial.println();
+  eeprom_user_input(false);
+
+  /*
+   * once all of the eeprom setup is done,
+   * set the debug level (see above for other comments)
+   */
+  log_set_level(pconfig->debug_level);  // already clamped to DBG_NONE .. DBG_VERBOSE
+  DEBUG_INFO("Debug level set to %d\n", log_level);
+
+  /*
+   * mount and/or reformat the littleFS
+   * wait to do this until after eeprom work so that
+   * we know whether to format the fs.
+   */
+  FSInfo fs_info;
+
+  if(pconfig->reformat == true)  {
+    DEBUG_INFO("Formatting the filesystem...\n");
+    if (!LittleFS.format())
+      DEBUG_ERROR("ERROR: Could not format the filesystem...\n");
+    else
+      DEBUG_INFO("Format successful\n");
+  }
+  DEBUG_INFO("Mounting the filesystem...\n");
+  if (!LittleFS.begin())
+    DEBUG_ERROR("ERROR: Could not mount the filesystem...\n");
+  else  {
+    LittleFS.info(fs_info);
+    DEBUG_INFO("Mount successful\n");
+    DEBUG_INFO("fsTotalBytes: %d\n", fs_info.totalBytes);
+    DEBUG_INFO("fsUsedBytes: %d\n", fs_info.usedBytes);
+  }
+  neo_lib_scan();
+
+  // initialize neopixel strip
+  DEBUG_INFO("Initialize neopixel strip with %d %s pixels...\n", pconfig->neocount, pmon_config->neotype);
+  if(pconfig->neocount > 0)
+    neo_init(pconfig->neocount, NEO_PIN, pconfig->neotype);
   else
-    neo_n_blinks(128, 0, 0, 3, 500);  // three red blinks ... NOTE: blocking function
+    neo_init(NEO_NUMPIXELS, NEO_PIN, pconfig->neotype);
+
+  DEBUG_INFO("Setting gamma correction to %s\n", pmon_config->neogamma);
+  neo_set_gamma_color(pconfig->neogamma);
 
   /*
    * start the default sequence from eeprom setting
+   * (only on this board, the others start their own)
    */
   if((strcmp(pmon_config->neodefault, "none") != 0) && (strlen(pmon_config->neodefault) > 0))  {
-    if(neo_set_sequence(pmon_config->neodefault, "") != NEO_SUCCESS)
+    if(playSequence(pmon_config->neodefault, "") != NEO_SUCCESS)
       DEBUG_ERROR("ERROR: Error setting default sequence %s\n", pmon_config->neodefault);
   }
 
@@ -895,6 +1653,57 @@ void setup(void) {
     digitalWrite(DEBUG_PIN, 0);
   }
 
+  /*
+   * the config button is read by boot_config_pin() once the pull-up settles
+   */
+  pinMode(PIN_CONFIG, INPUT_PULLUP);
+  boot.t_pin = millis();
+
+  /*
+   * setup wifi to use a fixed IP address
+   * attempt to convert the ip address from the eeprom, and
+   * if that fails load a default address
+   */
+  uint8_t ip[4]; // ip address as octets
+
+  /*
+   * if eeprom config indicates that DHCP is disabled,
+   * set the fixed ip address
+   */
+  DEBUG_INFO("DHCP Enable = <%s>\n", pmon_config->dhcp_enable);
+  if(pconfig->dhcp_enable == false)  {
+    DEBUG_INFO("... setting fixed address\n");
+    if(pconfig->ipaddr_ok == true)
+      memcpy(ip, pconfig->ipaddr, sizeof(ip));
+    else  {
+      DEBUG_ERROR("ERROR: Failed to convert eeprom IP address value ... loading default\n");
+      ip[0] = 192; ip[1] = 168; ip[2] = 1; ip[3] = 37;
+    }
+    const byte gateway[] = {192, 168, 1, 1}; // Gateway address
+    const byte subnet[] = {255, 255, 255, 0}; // Subnet mask
+    WiFi.config(ip, gateway, subnet); // Set static IP ... DZ added this
+  }
+
+  /*
+   * start WiFI ... DHCP by default, unless above is executed
+   * (the connection itself is made by bt_wifilib from loop())
+   */
+  WiFi.mode(WIFI_STA);
+
+  /*
+   * allow to address the device by the given name e.g. http://webserver
+   * saw a note in the reference manual that this had to happen before the WIFI.begin()
+   * doesn't seem to matter, but I caved to conventional wisdom.
+   */
+  WiFi.setHostname(HOSTNAME);
+
+  Serial.println("Press any key to change settings");
+  Serial.println("Press config physical button to start configuration SoftAP");
+  boot.t_prompt = millis();
+  boot_next(BOOT_WIFI_BEGIN);
+  DEBUG_INFO("Boot: setup done at %u mS\n", (unsigned)millis());
+  log_set_deferred(true);  // from here on log_service() writes the messages out from loop()
+
 }  // setup
 
 
@@ -902,8 +1711,36 @@ void setup(void) {
 void loop(void) {
 
 
-  server.handleClient(); // webserver requests
-  ArduinoOTA.handle();   // over-the-air firmware updates
+  // settings prompt, config button, WiFi and starting the web server
+  if(boot.state != BOOT_DONE)
+    boot_service();
+  if(boot.state != BOOT_WIFI_BEGIN)
+    wifi_service();   // connect, and reconnect if the connection drops
+
+  // webserver requests are handled asynchronously ... nothing to do here
+  if(boot.web_ready != 0)
+    ArduinoOTA.handle();   // over-the-air firmware updates
+
+  // a brightness command from the websocket
+  if(ws_brightness >= 0)  {
+    neo_set_brightness((uint8_t)ws_brightness);
+    ws_brightness = -1;
+  }
+
+  /*
+   * tell the web pages when the sequence changes (including a single
+   * shot sequence finishing on its own) and drop dead websocket clients
+   */
+  static int8_t ws_last_seq = -2;
+  static uint32_t ws_last_cleanup = 0;
+  if(seq_index != ws_last_seq)  {
+    ws_last_seq = seq_index;
+    wsPushState(NULL);
+  }
+  if((millis() - ws_last_cleanup) >= WS_CLEANUP_INTERVAL)  {
+    ws_last_cleanup = millis();
+    ws.cleanupClients();
+  }
 
   /*
    * checking whether updates to the neopixel array
@@ -916,11 +1753,34 @@ void loop(void) {
    * (apparent) update running slowp: ~1.5 mS pulse width every other call to neo_cycle_next()
    *
    */
+  /*
+   * a pixel stream arriving over udp takes over the strand from the
+   * sequences until it stops for NEO_UDP_TIMEOUT mS
+   */
+  bool streaming = neo_udp_service();
+
+  // clock beacons and scheduled play commands (button presses, and the other boards')
+  neo_sync_service();
+  playService();  // a sequence posted to /api/play
+
+  // re-index the sequence files after an upload or delete
+  neo_lib_service();
+#ifdef WEB_BUNDLE
+  webBundleService();
+#endif
+  mem_service();  // heap low-water mark
+  log_service();  // write out the log messages the UART has room for
+
   if(neo_timer_active)  {
 #if DEBUG_PIN >= 0
     digitalWrite(DEBUG_PIN, true);
 #endif
-    neo_cycle_next();      // neopixel updates
+    if(!streaming)
+      neo_cycle_next();      // neopixel updates
+    if(boot.first_frame == 0)  {
+      boot.first_frame = millis();
+      DEBUG_INFO("Boot: first frame at %u mS\n", (unsigned)boot.first_frame);
+    }
     neo_timer_active = false;
 #if DEBUG_PIN >= 0
     digitalWrite(DEBUG_PIN, false);
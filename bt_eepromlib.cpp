@@ -14,12 +14,18 @@
  * the user is prompted for, using get_all_eeprom_inputs().  It also provides
  * the strings necessary to create individual prompt messages.
  *
- * a version validation string is kept in EEPROM_VALID in sketch main file.
- * management of that string is currently done by main code.  Perhaps it should be moved.
+ * the eeprom holds a config_hdr (magic, layout version, length, write
+ * generation and CRC32) followed by mon_config.  eeprom_valid() checks
+ * the header and CRC, so a half-written or corrupted record is caught
+ * instead of being used.  records from before the header (valid_v0.8.x,
+ * where the only check was the validation string) and records behind a
+ * header with an older CONFIG_VERSION are migrated field by field on the
+ * first eeprom_get().
  *
  * eeprom_begin() is expected to be called in setup().
- * eeprom_get() copies the contents of the eeprom to mon_config.
- * eeprom_put() writes the contents of the eeprom with mon_config.
+ * eeprom_get() validates the eeprom and copies its contents to mon_config.
+ * eeprom_put() writes mon_config to the eeprom (only if it changed).
+ * get_config_values() returns the settings already converted from strings.
  *
  * Copied this from a previous project and modified it to work with this one - DJZ
  *
@@ -29,17 +35,46 @@
 #include <stdlib.h>  // for atoi()
 #include <string.h>  // for strncpy()
 #include <ctype.h>  // for isdigit()
+#include <stddef.h>  // for offsetof()
 #include <ArduinoJson.h>
 #include <Arduino_DebugUtils.h>
 
 #include <EEPROM.h>
+#include <coredecls.h>  // for crc32()
+#include <Adafruit_NeoPixel.h>  // for the NEO_* pixel types
 
 #include "bt_eepromlib.h"
+#include "bt_fsio.h"
 
 /*
  * place to hold the settings for network, mqtt, calibration, etc.
  */
 struct net_config mon_config;
+struct config_values mon_values;
+
+/*
+ * the record starts after the header
+ */
+#define CONFIG_DATA_OFFSET  sizeof(config_hdr)
+static_assert((sizeof(config_hdr) + sizeof(net_config)) <= WIFI_CACHE_OFFSET, "net_config runs into the wifi cache");
+static_assert((WIFI_CACHE_OFFSET + sizeof(wifi_cache)) <= EEPROM_RESERVE, "wifi cache does not fit in EEPROM_RESERVE");
+
+/*
+ * headerless layouts written before CONFIG_VERSION 3.  these were net_config
+ * at offset 0, identified only by the validation string.  the fields were
+ * only ever appended, so a legacy record is the leading "length" bytes
+ * of the current net_config.
+ */
+struct config_legacy  {
+  const char *valid;
+  uint16_t length;
+};
+
+static const config_legacy legacy_layouts[] = {
+  {"valid_v0.8.1", offsetof(net_config, syncrole)},
+  {"valid_v0.8.2", offsetof(net_config, syncrole) + sizeof(mon_config.syncrole)},
+};
+#define CONFIG_LEGACY_CNT  (sizeof(legacy_layouts) / sizeof(config_legacy))
 
 /*
  * this section deals with getting the user input to
@@ -59,7 +94,7 @@ struct eeprom_in  {
 /*
  * NOTE: validation must be at index = 0
  */
-#define EEPROM_ITEMS 12
+#define EEPROM_ITEMS 14
 struct eeprom_in eeprom_input[EEPROM_ITEMS] {
   {"",                                           "Validation",    "",                                       mon_config.valid,            sizeof(mon_config.valid)},
   {"DHCP Enable (true, false)",                  "WIFI_DHCP",     "false",                                  mon_config.dhcp_enable,      sizeof(mon_config.dhcp_enable)},
@@ -73,6 +108,8 @@ struct eeprom_in eeprom_input[EEPROM_ITEMS] {
   {"Neopixel gamma (true, false)",               "neo_gamma",     "true",                                   mon_config.neogamma,         sizeof(mon_config.neogamma)},
   {"Enter default seq label (or \"none\")",      "def_neo_seq",   "none",                                   mon_config.neodefault,       sizeof(mon_config.neodefault)},
   {"Reformat FS (true, false)",                  "FS_reformat",   "false",                                  mon_config.reformat,         sizeof(mon_config.reformat)},
+  {"Board sync (leader, follower, none)",        "sync_role",     "none",                                   mon_config.syncrole,         sizeof(mon_config.syncrole)},
+  {"Neopixel order (GRB, RGB, GRBW, RGBW)",      "neo_type",      "GRB",                                    mon_config.neotype,          sizeof(mon_config.neotype)},
 };
 
 /*
@@ -97,6 +134,8 @@ void init_eeprom_input()  {
     eeprom_input[9].value = mon_config.neogamma;
     eeprom_input[10].value = mon_config.neodefault;
     eeprom_input[11].value = mon_config.reformat;
+    eeprom_input[12].value = mon_config.syncrole;
+    eeprom_input[13].value = mon_config.neotype;
 }
 
 /*
@@ -107,6 +146,55 @@ net_config *get_mon_config_ptr(void) {
 	return(&mon_config);
 }
 
+const config_values *get_config_values(void)  {
+  return(&mon_values);
+}
+
+/*
+ * the pixel color orders that can be configured (see neo_pixel.cpp)
+ */
+struct config_neotype  {
+  const char *name;
+  uint16_t type;
+};
+
+static const config_neotype neotypes[] = {
+  {"GRB",  NEO_GRB + NEO_KHZ800},
+  {"RGB",  NEO_RGB + NEO_KHZ800},
+  {"GRBW", NEO_GRBW + NEO_KHZ800},
+  {"RGBW", NEO_RGBW + NEO_KHZ800},
+};
+
+/*
+ * convert the strings in mon_config once so that the rest of
+ * the code doesn't have to (and doesn't each do it differently)
+ */
+static void config_parse(void)  {
+  int32_t value;
+
+  mon_values.dhcp_enable = (strcmp(mon_config.dhcp_enable, "false") != 0);
+  mon_values.ipaddr_ok = (eeprom_convert_ip(mon_config.ipaddr, mon_values.ipaddr) == 0);
+
+  if(strlen(mon_config.wifitries) > 0)
+    mon_values.wifitries = constrain(atoi(mon_config.wifitries), -1, 127);
+  else
+    mon_values.wifitries = -1;
+
+  mon_values.debug_level = constrain(atoi(mon_config.debug_level), -1, 4);
+
+  value = atoi(mon_config.neocount);
+  mon_values.neocount = constrain(value, 0, 65535);
+
+  mon_values.neogamma = (strcmp(mon_config.neogamma, "true") == 0);
+
+  mon_values.neotype = neotypes[0].type;
+  for(uint8_t i = 0; i < (sizeof(neotypes) / sizeof(config_neotype)); i++)  {
+    if(strcmp(mon_config.neotype, neotypes[i].name) == 0)
+      mon_values.neotype = neotypes[i].type;
+  }
+  mon_values.reformat = (strcmp(mon_config.reformat, "true") == 0);
+}
+
 /*
  * prompt for and set one input in eeprom_input[].value.
  * return: that which comes back from l_read_string()
@@ -175,31 +263,71 @@ void dispall_eeprom_parms()  {
 }
 
 /*
- * read exactly the number of bytes from eeprom 
- * that match[] is long and compare to see if the eeprom has
- * ever been written with a valid set of data from this
- * exact revision.
- * 
- * returns the value of strcmp()
+ * check the header in the eeprom and the CRC of the record that follows.
+ * the CRC is calculated straight from the EEPROM class buffer.
  */
-bool eeprom_validation(char match[])  {
-  int mlen;
-  char ebuf[32];
-  char in;
-  int i;
+static bool config_hdr_ok(const config_hdr &hdr)  {
+  const uint8_t *data = EEPROM.getConstDataPtr() + CONFIG_DATA_OFFSET;
 
-  mlen = strlen(match);
+  if((hdr.magic != CONFIG_MAGIC) || (hdr.version != CONFIG_VERSION) || (hdr.length != sizeof(net_config)))
+    return(false);
+  return(crc32(data, sizeof(net_config)) == hdr.crc);
+}
 
-  for(i = 0; i < mlen; i++)
-    ebuf[i] = EEPROM.get(i, in);
-  ebuf[i] = '\0';
-  
-#ifdef FL_DEBUG_MSG
-  Serial.print("match ->");Serial.print(match); Serial.println("<-");
-  Serial.print("ebuf ->");Serial.print(ebuf); Serial.println("<-");
-#endif
-  
-  return(strcmp(match, ebuf));
+/*
+ * a record behind a good header, but from an older CONFIG_VERSION.
+ * the CRC covers the length that was written then.
+ */
+static bool config_hdr_old(const config_hdr &hdr)  {
+  const uint8_t *data = EEPROM.getConstDataPtr() + CONFIG_DATA_OFFSET;
+
+  if((hdr.magic != CONFIG_MAGIC) || (hdr.version < 3) || (hdr.version >= CONFIG_VERSION) ||
+     (hdr.length > sizeof(net_config)))
+    return(false);
+  return(crc32(data, hdr.length) == hdr.crc);
+}
+
+/*
+ * return the index of the legacy layout in the eeprom, or -1 if none
+ */
+static int8_t config_legacy_find(void)  {
+  const char *data = (const char *)EEPROM.getConstDataPtr();
+
+  for(uint8_t i = 0; i < CONFIG_LEGACY_CNT; i++)  {
+    if(strncmp(data, legacy_layouts[i].valid, sizeof(mon_config.valid)) == 0)
+      return(i);
+  }
+  return(-1);
+}
+
+/*
+ * copy an older record of length bytes into mon_config.
+ * anything the old layout didn't have keeps its default.
+ */
+static void config_migrate(const char *data, uint16_t length)  {
+  uint16_t offset;
+
+  set_eeprom_initial();
+  for(int8_t i = 1; i < EEPROM_ITEMS; i++)  {
+    offset = eeprom_input[i].value - (char *)&mon_config;
+    if((offset + eeprom_input[i].buflen) <= length)  {
+      memcpy(eeprom_input[i].value, data + offset, eeprom_input[i].buflen);
+      eeprom_input[i].value[eeprom_input[i].buflen - 1] = '\0';
+    }
+  }
+}
+
+/*
+ * has the eeprom ever been written with a valid set of data,
+ * either in the current layout or one that can be migrated
+ */
+bool eeprom_valid(void)  {
+  config_hdr hdr;
+
+  EEPROM.get(0, hdr);
+  if((config_hdr_ok(hdr) == true) || (config_hdr_old(hdr) == true))
+    return(true);
+  return(config_legacy_find() >= 0);
 }
 
 /*
@@ -301,13 +429,106 @@ void eeprom_begin(void) {
 	EEPROM.begin(EEPROM_RESERVE);
 }
 
-void eeprom_get(void) {
-	EEPROM.get(0, mon_config);
+/*
+ * validate and load the eeprom into mon_config (and mon_values).
+ * a legacy record is migrated and written back once in the
+ * current layout.
+ * return: true if valid data was loaded, mon_config is unchanged if not.
+ */
+bool eeprom_get(void) {
+  config_hdr hdr;
+  int8_t layout;
+
+  EEPROM.get(0, hdr);
+  if(config_hdr_ok(hdr) == true)  {
+    EEPROM.get(CONFIG_DATA_OFFSET, mon_config);
+    mon_values.generation = hdr.generation;
+  }
+  else if(config_hdr_old(hdr) == true)  {
+    Serial.print("EEPROM: migrating settings from config version ");
+    Serial.println(hdr.version);
+    config_migrate((const char *)EEPROM.getConstDataPtr() + CONFIG_DATA_OFFSET, hdr.length);
+    mon_values.generation = hdr.generation;
+    eeprom_put();
+  }
+  else if((layout = config_legacy_find()) >= 0)  {
+    Serial.print("EEPROM: migrating settings from ");
+    Serial.println(legacy_layouts[layout].valid);
+    config_migrate((const char *)EEPROM.getConstDataPtr(), legacy_layouts[layout].length);
+    mon_values.generation = 0;
+    eeprom_put();
+  }
+  else
+    return(false);
+
+  config_parse();
+  return(true);
 }
 
+/*
+ * write mon_config to the eeprom behind a new header.
+ * the ESP8266 EEPROM class erases and rewrites the whole flash sector on
+ * every commit(), so the only way to save wear is to not commit:
+ * if the record in the eeprom is valid and identical, nothing is written.
+ */
 void eeprom_put(void) {
-	EEPROM.put(0, mon_config);
-	EEPROM.commit();
+  config_hdr hdr;
+  uint32_t crc;
+
+  strncpy(mon_config.valid, EEPROM_VALID, sizeof(mon_config.valid));
+  crc = crc32(&mon_config, sizeof(mon_config));
+
+  EEPROM.get(0, hdr);
+  if(config_hdr_ok(hdr) == true)  {
+    if((hdr.crc == crc) && (memcmp(EEPROM.getConstDataPtr() + CONFIG_DATA_OFFSET, &mon_config, sizeof(mon_config)) == 0))  {
+      Serial.println("EEPROM: settings unchanged ... not written");
+      config_parse();
+      return;
+    }
+    hdr.generation++;
+  }
+  else if(config_hdr_old(hdr) == true)
+    hdr.generation++;  // the record being migrated keeps counting
+  else
+    hdr.generation = 1;
+
+  hdr.magic = CONFIG_MAGIC;
+  hdr.version = CONFIG_VERSION;
+  hdr.length = sizeof(mon_config);
+  hdr.crc = crc;
+
+  EEPROM.put(CONFIG_DATA_OFFSET, mon_config);
+  EEPROM.put(0, hdr);
+  if(fsio_commit(FSIO_EEPROM_CONFIG) == false)
+    Serial.println("EEPROM: ERROR: commit failed");
+
+  mon_values.generation = hdr.generation;
+  config_parse();
+}
+
+/*
+ * the wifi cache has its own CRC, separate from the config record,
+ * so that a bad cache is just ignored (the next connect is a normal one)
+ */
+static uint32_t wifi_cache_crc(const wifi_cache *cache)  {
+  return(crc32((const uint8_t *)cache + sizeof(cache->crc), sizeof(wifi_cache) - sizeof(cache->crc)));
+}
+
+bool eeprom_get_wifi_cache(wifi_cache *cache)  {
+  EEPROM.get(WIFI_CACHE_OFFSET, *cache);
+  return(wifi_cache_crc(cache) == cache->crc);
+}
+
+void eeprom_put_wifi_cache(wifi_cache *cache)  {
+  wifi_cache old;
+
+  cache->crc = wifi_cache_crc(cache);
+  if((eeprom_get_wifi_cache(&old) == true) && (memcmp(&old, cache, sizeof(old)) == 0))
+    return;
+
+  EEPROM.put(WIFI_CACHE_OFFSET, *cache);
+  if(fsio_commit(FSIO_EEPROM_WIFI) == false)
+    Serial.println("EEPROM: ERROR: wifi cache commit failed");
 }
 
 void eeprom_user_input(bool out)  {
@@ -331,8 +552,7 @@ void eeprom_user_input(bool out)  {
      *
      * ... proceed to get user input
      */
-    if(eeprom_validation((char *)EEPROM_VALID) == 0)  {
-      eeprom_get();  /* if the EEPROM is valid, get the whole contents */
+    if(eeprom_get() == true)  {  /* if the EEPROM is valid, get the whole contents */
       Serial.println();
       dispall_eeprom_parms();
     }
@@ -356,7 +576,7 @@ void eeprom_user_input(bool out)  {
     /*
      * if agreed, write the new data to the EEPROM and use it
      */
-    if(eeprom_validation((char *)EEPROM_VALID) == 0)
+    if(eeprom_valid() == true)
       Serial.print("EEPROM: previous data exists ... ");
     else
       Serial.print("EEPROM data never initialized ... ");
@@ -381,19 +601,20 @@ void eeprom_user_input(bool out)  {
      */
     if(strcmp(inbuf, "y") == 0)  {
       Serial.println("Writing data to EEPROM ...");
-      strcpy(mon_config.valid, EEPROM_VALID);
       eeprom_put();
     }
   } /* entering new data */
   
-  if(eeprom_validation((char *)EEPROM_VALID) == 0)  {
-    eeprom_get();
-    Serial.println("EEPROM data valid ... using it");
+  if(eeprom_get() == true)  {
+    Serial.print("EEPROM data valid (generation ");
+    Serial.print(mon_values.generation);
+    Serial.println(") ... using it");
     dispall_eeprom_parms();
   }
   else  {
     Serial.println("EEPROM data NOT valid ... reset and try enter valid data");
     Serial.read();
+    config_parse();  /* so the values are consistent with the (empty) strings */
   }
 }
 
@@ -466,20 +687,21 @@ int8_t eeprom_convert_ip(char *sipaddr, uint8_t octets[])  {
 }
 
 /*
- * dynamically create the html form with default values from 
- * the current EEPROM values
- * if overflow occurs, the result is truncated.
+ * dynamically create the html form with default values from
+ * the current EEPROM values, one field at a time, handing each
+ * piece to out() (e.g. to send it straight to the client) so that
+ * the whole form is never held in RAM.
  *
  * arguments:
- *  buf -  character buffer to accumulate html/js
- *         expected to have some contents (e.g. js) when passed
- *  size - characters left in the buffer before overflow
+ *  out - called with each piece of the html, in order
  */
-void createHTMLfromEEPROM(char *buf, int size)  {
-  buf[0] = '\0';
+#define HTML_FIELD_SIZE 384  // one <label>/<input> pair: 4 labels + value + markup
 
-  if(eeprom_validation((char *)EEPROM_VALID) == 0)  {
-    eeprom_get();  /* if the EEPROM is valid, get the whole contents */
+void streamHTMLfromEEPROM(void (*out)(const char *buf, size_t len))  {
+  char field[HTML_FIELD_SIZE];
+  int n;
+
+  if(eeprom_get() == true)  {  /* if the EEPROM is valid, get the whole contents */
     init_eeprom_input();
   }
   else  {
@@ -488,41 +710,23 @@ void createHTMLfromEEPROM(char *buf, int size)  {
   }
 
   /*
-   * loop through creating the input elements of the html from the eeprom contents
-   * start at 1 to skip the validation element
-   * initial total string length was 898
-   * note that strncpy() attempts to pad the full (n) bytes with '\0' and can overflow
-   *
-   * WARNING: you are very close to the RAM limit and printf()'s and the like
-   * seem to malloc() a large buffer for large strings and cause an exception/reboot.
+   * one piece per input element, starting at 1 to skip the validation element
    */
-  int bufsize = size - 1;  // I think I have to save one for the final '\0'
-
-  strncpy((char*)(buf+strlen(buf)), "\t<form onsubmit=\"deviceConfig(event)\">\n",                             (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
+  n = snprintf(field, sizeof(field), "\t<form onsubmit=\"deviceConfig(event)\">\n");
+  out(field, n);
   for(int parm = 1; parm < EEPROM_ITEMS; parm++)  {
-        strncpy((char*)(buf+strlen(buf)), "\t<label for=\"",                                                   (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), eeprom_input[parm].label,                                            (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), "\">",                                                               (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), eeprom_input[parm].label,                                            (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), " </label>\n",                                                       (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), "\t<input type=\"text\" class=\"config-input-field\" id=\"",         (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), eeprom_input[parm].label,                                            (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), "\" name=\"",                                                        (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), eeprom_input[parm].label,                                            (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), "\" value=\"",                                                       (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), eeprom_input[parm].value,                                            (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-        strncpy((char*)(buf+strlen(buf)), "\"/><br><br>\n",                                                     (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
+    n = snprintf(field, sizeof(field),
+                 "\t<label for=\"%s\">%s </label>\n"
+                 "\t<input type=\"text\" class=\"config-input-field\" id=\"%s\" name=\"%s\" value=\"%s\"/><br><br>\n",
+                 eeprom_input[parm].label, eeprom_input[parm].label,
+                 eeprom_input[parm].label, eeprom_input[parm].label, eeprom_input[parm].value);
+    out(field, min(n, (int)sizeof(field) - 1));
   }
-  strncpy((char*)(buf+strlen(buf)), "\t<button type=\"submit\" class=\"config-button\">Save</button>\n",                               (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-  strncpy((char*)(buf+strlen(buf)), "\t<button type=\"button\" class=\"config-button\" onclick=\"handleCancel()\">Reboot</button>\n", 
-                                                                                                               (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-  strncpy((char*)(buf+strlen(buf)), "\t</form>\n",                                                             (bufsize-strlen(buf) < 0 ? 0 : bufsize-strlen(buf)));
-  buf[bufsize] = '\0';  // just in case ... note already reduced by one above
-
-  Serial.print("html buflen=");
-  Serial.print(strlen(buf));
-  Serial.print("\n");
-
+  n = snprintf(field, sizeof(field),
+               "\t<button type=\"submit\" class=\"config-button\">Save</button>\n"
+               "\t<button type=\"button\" class=\"config-button\" onclick=\"handleCancel()\">Reboot</button>\n"
+               "\t</form>\n");
+  out(field, n);
 }
 
 /*
@@ -533,7 +737,7 @@ void createHTMLfromEEPROM(char *buf, int size)  {
  *  jsonDoc - jsonDoc containing the json formatted return 
  *    values from the browser based input
  */
-void saveJsonToEEPROM(JsonDocument jsonDoc)  {
+void saveJsonToEEPROM(JsonDocument &jsonDoc)  {
 
   for(int parm = 1; parm < EEPROM_ITEMS; parm++)  {
     if(jsonDoc[eeprom_input[parm].label].isNull() == false)  {
@@ -26,12 +26,30 @@
 #define EEPROM_INTRO_MSG "neopixel fun by daniel@basementtech and zimtech, LLC"
 
 /*
- * string to match for validation
- * this indicates the version/structure of the EEPROM too.
- * be sure to update this string if you change the 
- * net_config struct below.
+ * firmware/configuration version string, kept in net_config.valid
+ * for display.  (up to valid_v0.8.2 this string was the only
+ * validation of the EEPROM contents; see config_hdr below)
  */
-#define EEPROM_VALID  "valid_v0.8.1"
+#define EEPROM_VALID  "valid_v0.9.1"
+
+/*
+ * the EEPROM holds a config_hdr followed by net_config.
+ * the record is valid if the magic, version, length and CRC32 all match.
+ * be sure to bump CONFIG_VERSION if you change the net_config struct below.
+ * fields are only ever appended, so a record with an older version (and
+ * shorter length) behind a good header is migrated by eeprom_get() and
+ * the settings carry over instead of being reset to defaults.
+ */
+#define CONFIG_MAGIC    0x4746434E  // "NCFG"
+#define CONFIG_VERSION  4           // 1: valid_v0.8.1, 2: valid_v0.8.2 (no header), 3: valid_v0.9.0
+
+struct config_hdr  {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;       // sizeof(net_config)
+  uint32_t generation;   // number of times the record has been written
+  uint32_t crc;          // CRC32 of the net_config that follows
+};
 
 /*
  * map of the parameters stored in EEPROM
@@ -52,24 +70,64 @@ char neocount[8];        // number of neopixels in the strand
 char neogamma[8];        // gamma correction or not
 char neodefault[16];     // label of the sequence to load at start
 char reformat[8];        // reformat fs on startup
+char syncrole[12];       // board sync: leader, follower or none
+char neotype[8];         // pixel color order: GRB, RGB, GRBW or RGBW
 };
  
+/*
+ * the settings converted from their strings once, when they are
+ * loaded (or saved), so that the rest of the code doesn't re-parse them
+ */
+struct config_values  {
+  bool dhcp_enable;
+  uint8_t ipaddr[4];     // only valid if ipaddr_ok
+  bool ipaddr_ok;
+  int8_t wifitries;      // -1 if not set
+  int8_t debug_level;    // clamped to -1 .. 4
+  uint16_t neocount;     // 0 if not set
+  bool neogamma;
+  uint16_t neotype;      // Adafruit pixel type (NEO_GRB + NEO_KHZ800 if not recognized)
+  bool reformat;
+  uint32_t generation;   // times the config has been written (wear indicator)
+};
+
+/*
+ * the last good WiFi connection, kept in its own little record after
+ * the config so the next connect can go straight to the access point
+ * (see bt_wifilib.cpp).  it is only rewritten when it changes.
+ */
+#define WIFI_CACHE_OFFSET  768
+
+struct wifi_cache  {
+  uint32_t crc;          // CRC32 of the rest of the struct
+  int8_t source;         // which credentials connected (wifi_source_t)
+  uint8_t channel;
+  uint8_t bssid[6];      // the access point
+  uint32_t ip;           // the DHCP lease
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+};
+
 /*
  * function declarations
  */
 net_config *get_mon_config_ptr(void);
+const config_values *get_config_values(void);
 void eeprom_user_input(bool out);
 int getone_eeprom_input(int i);
 void getall_eeprom_inputs();
 void dispall_eeprom_parms();
-bool eeprom_validation(char match[]);
+bool eeprom_valid(void);
 int l_read_string(char *buf, int blen, bool echo);
 int8_t eeprom_convert_ip(char *sipaddr, uint8_t octets[]);
-void createHTMLfromEEPROM(char *buf, int size);
-void saveJsonToEEPROM(JsonDocument jsonDoc);
+void streamHTMLfromEEPROM(void (*out)(const char *buf, size_t len));
+void saveJsonToEEPROM(JsonDocument &jsonDoc);
 
 void eeprom_begin(void);
-void eeprom_get(void);
+bool eeprom_get(void);
 void eeprom_put(void);
+bool eeprom_get_wifi_cache(wifi_cache *cache);
+void eeprom_put_wifi_cache(wifi_cache *cache);
 
 #endif
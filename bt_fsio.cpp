@@ -0,0 +1,138 @@
+/*
+ * flash I/O accounting
+ * --------------------
+ * the wrappers do the LittleFS/EEPROM call, time it with micros() and
+ * add it to the caller's site.  reads by a library straight from a File
+ * (e.g. deserializeJson()) are added with fsio_note_read().
+ *
+ * erases: EEPROM.commit() always erases and rewrites its one sector.
+ * LittleFS writes a file into fresh blocks, so closing a file that was
+ * written counts one erase per FSIO_BLOCK written (metadata updates and
+ * the wear leveling moves are not seen, so it's a lower bound).
+ * LittleFS spreads its erases over the whole file system but the EEPROM
+ * sector takes every one of its own, so that's the one to watch.
+ *
+ * the async web server serves static files (and hashes them for the ETags)
+ * from inside the library, so that traffic isn't counted.
+ */
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <LittleFS.h>
+
+#include "bt_fsio.h"
+
+static fsio_stats_t fsio_stats[FSIO_SITES];
+
+static const char *fsio_names[FSIO_SITES] = {
+  "sequence load",
+  "sequence index",
+  "stream",
+  "upload",
+  "save",
+  "config page",
+  "fs info",
+  "eeprom config",
+  "eeprom wifi",
+};
+
+static inline void fsio_time(fsio_site_t site, uint32_t t_start)  {
+  fsio_stats[site].us += micros() - t_start;
+}
+
+File fsio_open(fsio_site_t site, const char *path, const char *mode)  {
+  uint32_t t = micros();
+  File fd = LittleFS.open(path, mode);
+
+  fsio_stats[site].opens++;
+  fsio_time(site, t);
+  return(fd);
+}
+
+File fsio_open(fsio_site_t site, Dir &dir, const char *mode)  {
+  uint32_t t = micros();
+  File fd = dir.openFile(mode);
+
+  fsio_stats[site].opens++;
+  fsio_time(site, t);
+  return(fd);
+}
+
+size_t fsio_read(fsio_site_t site, File &fd, uint8_t *buf, size_t len)  {
+  uint32_t t = micros();
+
+  len = fd.read(buf, len);
+  fsio_note_read(site, len, t);
+  return(len);
+}
+
+void fsio_note_read(fsio_site_t site, size_t len, uint32_t t_start)  {
+  fsio_stats[site].reads++;
+  fsio_stats[site].bytes_read += len;
+  fsio_time(site, t_start);
+}
+
+size_t fsio_write(fsio_site_t site, File &fd, const uint8_t *buf, size_t len)  {
+  uint32_t t = micros();
+
+  len = fd.write(buf, len);
+  fsio_stats[site].writes++;
+  fsio_stats[site].bytes_written += len;
+  fsio_stats[site].pending += len;
+  fsio_time(site, t);
+  return(len);
+}
+
+/*
+ * close, counting the blocks the file took if it was written
+ */
+void fsio_close(fsio_site_t site, File &fd)  {
+  uint32_t t = micros();
+
+  fd.close();
+  fsio_stats[site].erases += (fsio_stats[site].pending + FSIO_BLOCK - 1) / FSIO_BLOCK;
+  fsio_stats[site].pending = 0;
+  fsio_time(site, t);
+}
+
+bool fsio_info(fsio_site_t site, FSInfo &info)  {
+  uint32_t t = micros();
+  bool ret = LittleFS.info(info);
+
+  fsio_stats[site].opens++;  // it walks the file system, about the cost of an open
+  fsio_time(site, t);
+  return(ret);
+}
+
+/*
+ * EEPROM.commit() ... the callers only commit after they have
+ * changed something, so every call is an erase and a full write
+ */
+bool fsio_commit(fsio_site_t site)  {
+  uint32_t t = micros();
+  bool ret = EEPROM.commit();
+
+  fsio_stats[site].writes++;
+  fsio_stats[site].bytes_written += EEPROM.length();
+  fsio_stats[site].erases++;
+  fsio_time(site, t);
+  return(ret);
+}
+
+const char *fsio_site_name(uint8_t site)  {
+  return((site < FSIO_SITES) ? fsio_names[site] : NULL);
+}
+
+const fsio_stats_t *fsio_get_stats(uint8_t site)  {
+  return((site < FSIO_SITES) ? &fsio_stats[site] : NULL);
+}
+
+/*
+ * total erases since boot
+ */
+uint32_t fsio_erases(void)  {
+  uint32_t n = 0;
+
+  for(uint8_t i = 0; i < FSIO_SITES; i++)
+    n += fsio_stats[i].erases;
+  return(n);
+}
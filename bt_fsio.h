@@ -0,0 +1,54 @@
+/*
+ * bt_fsio.h
+ * ------
+ * counted LittleFS and EEPROM access: each call site passes its
+ * fsio_site_t and the opens, bytes, flash erases and time spent
+ * are added up per site (served at /$fsio).
+ */
+
+#ifndef __BT_FSIO_H__
+#define __BT_FSIO_H__
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define FSIO_BLOCK  4096  // flash erase block (LittleFS block and the EEPROM sector)
+
+typedef enum {
+  FSIO_SEQ_LOAD = 0,  // neo_load_sequence()
+  FSIO_SEQ_INDEX,     // neo_lib_scan()
+  FSIO_STREAM,        // animation frames
+  FSIO_UPLOAD,        // file uploads (and the compare with the old file)
+  FSIO_SAVE,          // sequences saved from the web page
+  FSIO_CONFIG_PAGE,   // the SoftAP config page
+  FSIO_FS_INFO,       // LittleFS.info() for /$sysinfo
+  FSIO_EEPROM_CONFIG, // eeprom_put()
+  FSIO_EEPROM_WIFI,   // eeprom_put_wifi_cache()
+  FSIO_SITES,
+} fsio_site_t;
+
+typedef struct {
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t bytes_read;
+  uint32_t writes;
+  uint32_t bytes_written;
+  uint32_t erases;   // blocks erased (estimated for LittleFS, see fsio_close())
+  uint32_t us;       // time spent in the calls
+  uint32_t pending;  // bytes written to the open file (for the erase estimate)
+} fsio_stats_t;
+
+File fsio_open(fsio_site_t site, const char *path, const char *mode);
+File fsio_open(fsio_site_t site, Dir &dir, const char *mode);
+size_t fsio_read(fsio_site_t site, File &fd, uint8_t *buf, size_t len);
+size_t fsio_write(fsio_site_t site, File &fd, const uint8_t *buf, size_t len);
+void fsio_close(fsio_site_t site, File &fd);
+bool fsio_info(fsio_site_t site, FSInfo &info);
+bool fsio_commit(fsio_site_t site);
+void fsio_note_read(fsio_site_t site, size_t len, uint32_t t_start);
+
+const char *fsio_site_name(uint8_t site);
+const fsio_stats_t *fsio_get_stats(uint8_t site);
+uint32_t fsio_erases(void);
+
+#endif
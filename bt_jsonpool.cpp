@@ -0,0 +1,209 @@
+/*
+ * fixed arena allocator for ArduinoJson
+ * -------------------------------------
+ * the arena is a static buffer carved into blocks, each with an 8 byte
+ * header holding its size.  free blocks are kept on a list in address
+ * order so that neighbours are merged again when they are freed, and
+ * allocation is first fit.  ArduinoJson grows strings with reallocate(),
+ * so a block is grown in place when the block after it is free.
+ *
+ * the arena is static, so however many documents come and go the heap
+ * doesn't get chopped up by them.
+ * if a request doesn't fit, it goes to malloc() (and is counted),
+ * so a document never fails just because the arena is busy.
+ */
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "bt_jsonpool.h"
+
+#define POOL_ALIGN     8
+#define POOL_MIN_SPLIT 16  // don't leave free blocks smaller than this
+
+typedef struct pool_hdr {
+  uint32_t size;          // bytes in the block including this header
+  struct pool_hdr *next;  // next free block (only used while free)
+} pool_hdr_t;
+
+static_assert(sizeof(pool_hdr_t) == POOL_ALIGN, "pool header must keep the blocks aligned");
+
+static uint64_t pool_arena[JSON_POOL_SIZE / sizeof(uint64_t)];  // uint64_t for the alignment
+static pool_hdr_t *pool_free = NULL;
+static bool pool_ready = false;
+static json_pool_stats_t pool_stats;
+
+static inline bool pool_owns(void *p)  {
+  return(((uint8_t *)p >= (uint8_t *)pool_arena) && ((uint8_t *)p < ((uint8_t *)pool_arena + sizeof(pool_arena))));
+}
+
+static inline size_t pool_need(size_t size)  {
+  return(((size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1)) + sizeof(pool_hdr_t));
+}
+
+static void pool_init(void)  {
+  pool_free = (pool_hdr_t *)pool_arena;
+  pool_free->size = sizeof(pool_arena);
+  pool_free->next = NULL;
+  pool_ready = true;
+}
+
+/*
+ * put a block back on the free list, merging it with its neighbours
+ */
+static void pool_release(pool_hdr_t *blk)  {
+  pool_hdr_t *prev = NULL;
+  pool_hdr_t *next = pool_free;
+
+  while((next != NULL) && (next < blk))  {
+    prev = next;
+    next = next->next;
+  }
+
+  blk->next = next;
+  if((next != NULL) && (((uint8_t *)blk + blk->size) == (uint8_t *)next))  {
+    blk->size += next->size;
+    blk->next = next->next;
+  }
+
+  if(prev == NULL)
+    pool_free = blk;
+  else if(((uint8_t *)prev + prev->size) == (uint8_t *)blk)  {
+    prev->size += blk->size;
+    prev->next = blk->next;
+  }
+  else
+    prev->next = blk;
+}
+
+/*
+ * cut need bytes off the front of free block blk (unlinked by the caller),
+ * returning the rest to the free list
+ */
+static void pool_split(pool_hdr_t *blk, size_t need)  {
+  pool_hdr_t *rest;
+
+  if((blk->size - need) >= POOL_MIN_SPLIT)  {
+    rest = (pool_hdr_t *)((uint8_t *)blk + need);
+    rest->size = blk->size - need;
+    blk->size = need;
+    pool_release(rest);
+  }
+}
+
+static void *pool_alloc(size_t size)  {
+  size_t need = pool_need(size);
+  pool_hdr_t *prev = NULL;
+  pool_hdr_t *blk;
+
+  if(pool_ready == false)
+    pool_init();
+
+  for(blk = pool_free; blk != NULL; prev = blk, blk = blk->next)  {
+    if(blk->size >= need)  {
+      if(prev == NULL)
+        pool_free = blk->next;
+      else
+        prev->next = blk->next;
+      pool_split(blk, need);
+
+      pool_stats.allocs++;
+      pool_stats.used += blk->size;
+      if(pool_stats.used > pool_stats.peak)
+        pool_stats.peak = pool_stats.used;
+      return((uint8_t *)blk + sizeof(pool_hdr_t));
+    }
+  }
+
+  pool_stats.fallbacks++;
+  return(malloc(size));
+}
+
+static void pool_dealloc(void *p)  {
+  pool_hdr_t *blk;
+
+  if(p == NULL)
+    return;
+  if(pool_owns(p) == false)  {
+    free(p);
+    return;
+  }
+  blk = (pool_hdr_t *)((uint8_t *)p - sizeof(pool_hdr_t));
+  pool_stats.used -= blk->size;
+  pool_release(blk);
+}
+
+static void *pool_realloc(void *p, size_t size)  {
+  size_t need = pool_need(size);
+  pool_hdr_t *blk, *prev, *next;
+  uint32_t old;
+  void *np;
+
+  if(p == NULL)
+    return(pool_alloc(size));
+  if(pool_owns(p) == false)
+    return(realloc(p, size));
+
+  blk = (pool_hdr_t *)((uint8_t *)p - sizeof(pool_hdr_t));
+  old = blk->size;
+
+  /*
+   * shrinking (ArduinoJson does this when a string is done): give back the tail
+   */
+  if(need <= blk->size)  {
+    pool_split(blk, need);
+    pool_stats.used -= (old - blk->size);
+    return(p);
+  }
+
+  /*
+   * growing: take the free block right after this one if it's big enough
+   */
+  for(prev = NULL, next = pool_free; (next != NULL) && (next < blk); prev = next, next = next->next)
+    ;
+  if((next != NULL) && (((uint8_t *)blk + blk->size) == (uint8_t *)next) && ((blk->size + next->size) >= need))  {
+    if(prev == NULL)
+      pool_free = next->next;
+    else
+      prev->next = next->next;
+    blk->size += next->size;
+    pool_split(blk, need);
+    pool_stats.used += (blk->size - old);
+    if(pool_stats.used > pool_stats.peak)
+      pool_stats.peak = pool_stats.used;
+    return(p);
+  }
+
+  /*
+   * otherwise move it
+   */
+  if((np = pool_alloc(size)) == NULL)
+    return(NULL);
+  memcpy(np, p, old - sizeof(pool_hdr_t));
+  pool_dealloc(p);
+  return(np);
+}
+
+class JsonPoolAllocator : public ArduinoJson::Allocator {
+ public:
+  void *allocate(size_t size) override {
+    return(pool_alloc(size));
+  }
+
+  void deallocate(void *pointer) override {
+    pool_dealloc(pointer);
+  }
+
+  void *reallocate(void *pointer, size_t new_size) override {
+    return(pool_realloc(pointer, new_size));
+  }
+};
+
+static JsonPoolAllocator pool_allocator;
+
+ArduinoJson::Allocator *json_pool(void)  {
+  return(&pool_allocator);
+}
+
+const json_pool_stats_t *json_pool_get_stats(void)  {
+  return(&pool_stats);
+}
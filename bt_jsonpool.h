@@ -0,0 +1,32 @@
+/*
+ * bt_jsonpool.h
+ * ------
+ * a fixed arena that every ArduinoJson document allocates from,
+ * so that parsing button presses, sequence files, etc. over and over
+ * doesn't fragment the heap:
+ *
+ *   JsonDocument jsonDoc(json_pool());
+ */
+
+#ifndef __BT_JSONPOOL_H__
+#define __BT_JSONPOOL_H__
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JSON_POOL_SIZE  8192  // bytes in the arena (the heap is used if it runs out)
+
+/*
+ * usage counters, reported in /$sysinfo
+ */
+typedef struct {
+  uint32_t used;       // bytes allocated from the arena now (including headers)
+  uint32_t peak;       // high-water mark of used
+  uint32_t allocs;     // allocations from the arena
+  uint32_t fallbacks;  // allocations that didn't fit and went to the heap
+} json_pool_stats_t;
+
+ArduinoJson::Allocator *json_pool(void);
+const json_pool_stats_t *json_pool_get_stats(void);
+
+#endif
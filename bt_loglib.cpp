@@ -0,0 +1,366 @@
+/*
+ * deferred logging
+ * ----------------
+ * a record is a header word (length in words, level), millis(), the format
+ * pointer and then the arguments as the format says they were passed:
+ * one word for ints/chars/pointers, two for long longs and doubles and
+ * the characters (with the '\0', rounded up to words) for %s.
+ * records are whole words and never wrap: if one doesn't fit at the end
+ * of the ring a pad header (length 0) sends the reader back to the start.
+ * when the ring is full the oldest records are dropped, and if they hadn't
+ * been written to Serial yet, that's reported as lost messages.
+ *
+ * until log_set_deferred(true) (the end of setup()) every message is
+ * written out as it is logged, so the boot output comes out in order
+ * with the Serial.print()s around it.
+ *
+ * nothing here is called from an interrupt, and loop() and the web server
+ * callbacks don't preempt each other, so there's no locking.
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+
+#include "bt_loglib.h"
+
+#define LOG_WORDS  (LOG_RING_SIZE / sizeof(uint32_t))
+#define LOG_HDR    3  // header, millis(), format
+
+static_assert(LOG_WORDS <= 0xFFFF, "LOG_RING_SIZE is too big for the 16 bit positions");
+static_assert(LOG_REC_MAX <= 0xFF, "LOG_REC_MAX has to fit in the header byte");
+
+typedef enum {
+  LOG_ARG_NONE,
+  LOG_ARG_INT,     // anything that is passed as 32 bits
+  LOG_ARG_LL,      // %lld etc.
+  LOG_ARG_DOUBLE,  // floats are passed as doubles
+  LOG_ARG_STR,
+} log_arg_t;
+
+int8_t log_level = DBG_VERBOSE;  // same as Debug until log_set_level()
+
+static uint32_t log_ring[LOG_WORDS];
+static uint16_t log_head = 0;       // where the next record goes
+static uint16_t log_tail = 0;       // oldest record
+static uint16_t log_used = 0;       // words in use (records and pads)
+static uint32_t log_next_seq = 0;   // number of the next record
+static uint32_t log_tail_seq = 0;   // number of the oldest record
+static bool log_deferred = false;
+
+static uint32_t drain_seq = 0;      // next record to write to Serial
+static uint16_t drain_pos = 0;
+static uint32_t drain_lost = 0;     // dropped before being written, not reported yet
+static uint32_t lost_total = 0;
+static char drain_line[LOG_LINE];
+static uint16_t drain_len = 0, drain_off = 0;
+
+/*
+ * the conversion that starts at the '%' in fmt
+ * return: its length (type is what kind of argument it takes)
+ */
+static uint8_t log_conv(const char *fmt, log_arg_t *type)  {
+  uint8_t n = 1, longs = 0;
+
+  while((fmt[n] != '\0') && (strchr("-+ #0123456789.", fmt[n]) != NULL))
+    n++;
+  while((fmt[n] != '\0') && (strchr("hlzjt", fmt[n]) != NULL))
+    if(fmt[n++] == 'l')
+      longs++;
+
+  switch(fmt[n])  {
+    case '\0':
+      *type = LOG_ARG_NONE;
+      return(n);
+    case '%':
+      *type = LOG_ARG_NONE;
+      break;
+    case 's':
+      *type = LOG_ARG_STR;
+      break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+      *type = LOG_ARG_DOUBLE;
+      break;
+    default:  // d i u x X o c p
+      *type = (longs >= 2) ? LOG_ARG_LL : LOG_ARG_INT;
+      break;
+  }
+  return(n + 1);
+}
+
+/*
+ * drop the oldest record (or the pad at the tail)
+ */
+static void log_drop(void)  {
+  uint8_t words = log_ring[log_tail] & 0xFF;
+
+  if(words == 0)  {
+    log_used -= LOG_WORDS - log_tail;
+    log_tail = 0;
+    return;
+  }
+  log_used -= words;
+  log_tail = (log_tail + words) % LOG_WORDS;
+  log_tail_seq++;
+
+  if((int32_t)(drain_seq - log_tail_seq) < 0)  {
+    drain_seq = log_tail_seq;
+    drain_pos = log_tail;
+    drain_lost++;
+    lost_total++;
+  }
+}
+
+static void log_put(const uint32_t *rec, uint8_t words)  {
+  uint16_t wrap = ((log_head + words) > LOG_WORDS) ? (LOG_WORDS - log_head) : 0;
+
+  while((LOG_WORDS - log_used) < (uint16_t)(wrap + words))
+    log_drop();
+  if(wrap > 0)  {
+    log_ring[log_head] = 0;  // pad
+    log_used += wrap;
+    log_head = 0;
+  }
+  memcpy(&log_ring[log_head], rec, words * sizeof(uint32_t));
+  log_head = (log_head + words) % LOG_WORDS;
+  log_used += words;
+  log_next_seq++;
+}
+
+/*
+ * bring a reader up to date: move it to the oldest record if its
+ * record has been dropped, and past a pad
+ * return: false if there's no record there (yet)
+ */
+static bool log_find(uint32_t *seq, uint16_t *pos)  {
+  if((int32_t)(*seq - log_tail_seq) < 0)  {
+    *seq = log_tail_seq;
+    *pos = log_tail;
+  }
+  if(*seq == log_next_seq)
+    return(false);
+  if((log_ring[*pos] & 0xFF) == 0)
+    *pos = 0;
+  return(true);
+}
+
+/*
+ * format the record at pos into line
+ * return: the number of chars
+ */
+static uint16_t log_format(uint16_t pos, char *line, size_t size)  {
+  const uint32_t *rec = &log_ring[pos];
+  const char *fmt = (const char *)rec[2];
+  uint8_t words = rec[0] & 0xFF;
+  uint8_t n = LOG_HDR, len;
+  char spec[16];
+  log_arg_t type;
+  size_t out = 0;
+  int r = 0;
+
+  while((*fmt != '\0') && (out < (size - 1)))  {
+    if(*fmt != '%')  {
+      line[out++] = *fmt++;
+      continue;
+    }
+    len = log_conv(fmt, &type);
+    if(type == LOG_ARG_NONE)  {
+      if(fmt[len - 1] == '%')
+        line[out++] = '%';
+      fmt += len;
+      continue;
+    }
+    if((n + (((type == LOG_ARG_LL) || (type == LOG_ARG_DOUBLE)) ? 2 : 1)) > words)  {
+      out += snprintf(line + out, size - out, "...");  // the arguments didn't all fit in the record
+      break;
+    }
+
+    len = min(len, (uint8_t)(sizeof(spec) - 1));
+    memcpy(spec, fmt, len);
+    spec[len] = '\0';
+    fmt += len;
+
+    switch(type)  {
+      case LOG_ARG_LL:  {
+        uint64_t v;
+        memcpy(&v, &rec[n], sizeof(v));
+        n += 2;
+        r = snprintf(line + out, size - out, spec, v);
+        } break;
+      case LOG_ARG_DOUBLE:  {
+        double v;
+        memcpy(&v, &rec[n], sizeof(v));
+        n += 2;
+        r = snprintf(line + out, size - out, spec, v);
+        } break;
+      case LOG_ARG_STR:  {
+        const char *s = (const char *)&rec[n];
+        n += (strlen(s) + sizeof(uint32_t)) / sizeof(uint32_t);
+        r = snprintf(line + out, size - out, spec, s);
+        } break;
+      default:
+        r = snprintf(line + out, size - out, spec, rec[n++]);
+        break;
+    }
+    if(r > 0)
+      out = min(out + r, size - 1);
+  }
+  out = min(out, size - 1);
+  line[out] = '\0';
+  return(out);
+}
+
+/*
+ * store a message (called by the DEBUG_* macros, once the level has passed)
+ */
+void log_write(int8_t level, const char *fmt, ...)  {
+  uint32_t rec[LOG_REC_MAX];
+  uint8_t n = LOG_HDR, len;
+  log_arg_t type;
+  va_list args;
+
+  va_start(args, fmt);
+  for(const char *p = fmt; *p != '\0'; )  {
+    if(*p != '%')  {
+      p++;
+      continue;
+    }
+    len = log_conv(p, &type);
+    p += len;
+
+    if(type == LOG_ARG_INT)  {
+      if(n >= LOG_REC_MAX)
+        break;
+      rec[n++] = va_arg(args, unsigned int);
+    }
+    else if((type == LOG_ARG_LL) || (type == LOG_ARG_DOUBLE))  {
+      if((n + 2) > LOG_REC_MAX)
+        break;
+      if(type == LOG_ARG_LL)  {
+        uint64_t v = va_arg(args, unsigned long long);
+        memcpy(&rec[n], &v, sizeof(v));
+      }
+      else  {
+        double v = va_arg(args, double);
+        memcpy(&rec[n], &v, sizeof(v));
+      }
+      n += 2;
+    }
+    else if(type == LOG_ARG_STR)  {
+      const char *s = va_arg(args, const char *);
+      size_t room = ((LOG_REC_MAX - n) * sizeof(uint32_t));
+      size_t slen;
+
+      if(room == 0)
+        break;
+      if(s == NULL)
+        s = "(null)";
+      slen = strnlen(s, min(room - 1, (size_t)LOG_STR_MAX));
+      memcpy(&rec[n], s, slen);
+      ((char *)&rec[n])[slen] = '\0';
+      n += (slen + sizeof(uint32_t)) / sizeof(uint32_t);
+    }
+  }
+  va_end(args);
+
+  rec[0] = n | ((uint8_t)level << 8);
+  rec[1] = millis();
+  rec[2] = (uint32_t)fmt;
+  log_put(rec, n);
+
+  if(log_deferred == false)
+    log_flush();
+}
+
+void log_set_level(int8_t level)  {
+  log_level = level;
+  Debug.setDebugLevel(level);
+}
+
+/*
+ * false: write each message as it is logged (boot)
+ * true: leave it to log_service()
+ */
+void log_set_deferred(bool deferred)  {
+  log_deferred = deferred;
+}
+
+/*
+ * the next piece of output for Serial
+ * return: false if there's nothing
+ */
+static bool log_drain_next(void)  {
+  uint8_t words;
+
+  drain_len = drain_off = 0;
+  if(drain_lost > 0)  {
+    drain_len = snprintf(drain_line, sizeof(drain_line), "[%u log messages lost]\n", (unsigned)drain_lost);
+    drain_len = min(drain_len, (uint16_t)(sizeof(drain_line) - 1));
+    drain_lost = 0;
+    return(true);
+  }
+  if(log_find(&drain_seq, &drain_pos) == false)
+    return(false);
+
+  words = log_ring[drain_pos] & 0xFF;
+  drain_len = log_format(drain_pos, drain_line, sizeof(drain_line));
+  drain_pos = (drain_pos + words) % LOG_WORDS;
+  drain_seq++;
+  return(true);
+}
+
+/*
+ * write out what the UART will take without waiting
+ * (called every time through loop())
+ */
+void log_service(void)  {
+  int room;
+
+  while((room = Serial.availableForWrite()) > 0)  {
+    if((drain_off >= drain_len) && (log_drain_next() == false))
+      return;
+    room = min(room, (int)(drain_len - drain_off));
+    Serial.write((const uint8_t *)drain_line + drain_off, room);
+    drain_off += room;
+  }
+}
+
+/*
+ * write out everything, waiting on the UART (e.g. before a restart)
+ */
+void log_flush(void)  {
+  do  {
+    if(drain_off < drain_len)
+      Serial.write((const uint8_t *)drain_line + drain_off, drain_len - drain_off);
+    drain_off = drain_len;
+  } while(log_drain_next() == true);
+}
+
+void log_first(log_cursor_t *cur)  {
+  cur->seq = log_tail_seq;
+  cur->pos = log_tail;
+}
+
+/*
+ * format the record at the cursor and move on to the next
+ * return: false at the end
+ */
+bool log_next(log_cursor_t *cur, uint32_t *ms, int8_t *level, char *line, size_t size)  {
+  uint32_t hdr;
+
+  if(log_find(&cur->seq, &cur->pos) == false)
+    return(false);
+
+  hdr = log_ring[cur->pos];
+  *ms = log_ring[cur->pos + 1];
+  *level = (int8_t)(hdr >> 8);
+  log_format(cur->pos, line, size);
+  cur->pos = (cur->pos + (hdr & 0xFF)) % LOG_WORDS;
+  cur->seq++;
+  return(true);
+}
+
+/*
+ * messages dropped before they were written to Serial, since boot
+ */
+uint32_t log_lost(void)  {
+  return(lost_total);
+}
@@ -0,0 +1,64 @@
+/*
+ * bt_loglib.h
+ * ------
+ * deferred logging: the DEBUG_* macros from Arduino_DebugUtils are
+ * redefined here to store a small binary record (format pointer plus
+ * arguments) in a RAM ring.  log_service(), from loop(), formats them
+ * and writes only as much as the UART will take without waiting.
+ * the ring keeps the recent history, which is served at /$log.
+ *
+ * include it after <Arduino_DebugUtils.h> in every file that uses DEBUG_*.
+ *
+ * NOTE: the format must be a string literal (it is kept by pointer and
+ *       formatted later) and %s arguments are copied, up to LOG_STR_MAX
+ *       characters.  * widths and precisions aren't supported.
+ */
+
+#ifndef __BT_LOGLIB_H__
+#define __BT_LOGLIB_H__
+
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+
+#define LOG_RING_SIZE  2048  // bytes of records kept
+#define LOG_REC_MAX    32    // max 32 bit words in one record (header included)
+#define LOG_STR_MAX    48    // max chars copied from a %s argument
+#define LOG_LINE       128   // max chars in a formatted message
+
+extern int8_t log_level;
+
+/*
+ * the level test is inline so a filtered call doesn't even
+ * evaluate its arguments
+ */
+#define LOG_AT(lvl, fmt, ...)  do { if(log_level >= (lvl)) log_write((lvl), fmt, ## __VA_ARGS__); } while(0)
+
+#undef DEBUG_ERROR
+#undef DEBUG_WARNING
+#undef DEBUG_INFO
+#undef DEBUG_DEBUG
+#undef DEBUG_VERBOSE
+#define DEBUG_ERROR(fmt, ...)    LOG_AT(DBG_ERROR, fmt, ## __VA_ARGS__)
+#define DEBUG_WARNING(fmt, ...)  LOG_AT(DBG_WARNING, fmt, ## __VA_ARGS__)
+#define DEBUG_INFO(fmt, ...)     LOG_AT(DBG_INFO, fmt, ## __VA_ARGS__)
+#define DEBUG_DEBUG(fmt, ...)    LOG_AT(DBG_DEBUG, fmt, ## __VA_ARGS__)
+#define DEBUG_VERBOSE(fmt, ...)  LOG_AT(DBG_VERBOSE, fmt, ## __VA_ARGS__)
+
+/*
+ * walks the records in the ring for /$log
+ */
+typedef struct {
+  uint32_t seq;
+  uint16_t pos;
+} log_cursor_t;
+
+void log_write(int8_t level, const char *fmt, ...);
+void log_set_level(int8_t level);
+void log_set_deferred(bool deferred);
+void log_service(void);
+void log_flush(void);
+void log_first(log_cursor_t *cur);
+bool log_next(log_cursor_t *cur, uint32_t *ms, int8_t *level, char *line, size_t size);
+uint32_t log_lost(void);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * memory telemetry
+ * ----------------
+ * static sizes come from the declarations (so they are known when compiling
+ * and checked against MEM_STATIC_BUDGET), the total static RAM from the
+ * linker's section symbols, and the stack high-water mark from the core:
+ * it fills the loop() stack with a guard value at boot and
+ * ESP.getFreeContStack() counts how much of it is still untouched.
+ *
+ * the free heap is only sampled from loop() (mem_service()), so a dip
+ * inside a web server callback that is given back before loop() runs
+ * again is not seen.
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+#include <ESPAsyncWebServer.h>
+#include <cont.h>  // for CONT_STACKSIZE
+
+#include "bt_eepromlib.h"
+#include "bt_jsonpool.h"
+#include "bt_loglib.h"
+#include "bt_memlib.h"
+#include "neo_data.h"
+#include "neo_lib.h"
+
+extern "C" char _data_start[], _heap_start[];  // from the linker script
+
+#define MEM_SEQUENCES  sizeof(neo_sequences)
+#define MEM_LIB        ((NEO_LIB_MAX * sizeof(neo_lib_entry_t)) + NEO_LIB_HASH)
+#define MEM_WEB        (sizeof(AsyncWebServer) + sizeof(AsyncWebSocket))
+
+static_assert((MEM_SEQUENCES + JSON_POOL_SIZE + MEM_LIB + MEM_WEB + LOG_RING_SIZE) <= MEM_STATIC_BUDGET,
+              "static RAM is over MEM_STATIC_BUDGET (see bt_memlib.h)");
+
+static mem_stats_t mem_stats = {0, 0, 0, 0, CONT_STACKSIZE, 0};
+
+void mem_begin(void)  {
+  mem_stats.static_total = (uint32_t)(_heap_start - _data_start);
+  mem_stats.heap_boot = ESP.getFreeHeap();
+  mem_stats.heap_low = mem_stats.heap_boot;
+}
+
+void mem_service(void)  {
+  uint32_t heap = ESP.getFreeHeap();
+
+  if(heap < mem_stats.heap_low)
+    mem_stats.heap_low = heap;
+}
+
+/*
+ * the idx'th subsystem
+ * return: false past the last one
+ */
+bool mem_get_use(uint8_t idx, mem_use_t *use)  {
+  switch(idx)  {
+    case 0: *use = { "sequences", MEM_SEQUENCES, false };  break;
+    case 1: *use = { "json arena", JSON_POOL_SIZE, false };  break;
+    case 2: *use = { "sequence index", MEM_LIB, false };  break;
+    case 3: *use = { "web server", MEM_WEB, false };  break;
+    case 4: *use = { "log", LOG_RING_SIZE, false };  break;
+    case 5: *use = { "pixels", neo_heap_bytes(), true };  break;
+    case 6: *use = { "eeprom", EEPROM_RESERVE, true };  break;
+    default:
+      return(false);
+  }
+  return(true);
+}
+
+const mem_stats_t *mem_get_stats(void)  {
+  mem_service();
+  mem_stats.heap_free = ESP.getFreeHeap();
+  mem_stats.stack_used = CONT_STACKSIZE - ESP.getFreeContStack();
+  return(&mem_stats);
+}
+
+void mem_print(void)  {
+  const mem_stats_t *st = mem_get_stats();
+  mem_use_t use;
+
+  DEBUG_INFO("Memory: static %u, heap %u free (%u at boot, low %u), stack %u of %u used\n",
+             (unsigned)st->static_total, (unsigned)st->heap_free, (unsigned)st->heap_boot,
+             (unsigned)st->heap_low, (unsigned)st->stack_used, (unsigned)st->stack_size);
+  for(uint8_t i = 0; mem_get_use(i, &use) == true; i++)
+    DEBUG_INFO("  %-16s %6u %s\n", use.name, (unsigned)use.bytes, (use.heap ? "heap" : "static"));
+}
@@ -0,0 +1,42 @@
+/*
+ * bt_memlib.h
+ * ------
+ * where the RAM goes: the big static tables and heap buffers by
+ * subsystem, the loop() stack high-water mark and the lowest free heap
+ * since boot.  served at /$memory and printed once the web server is up.
+ */
+
+#ifndef __BT_MEMLIB_H__
+#define __BT_MEMLIB_H__
+
+#include <Arduino.h>
+
+/*
+ * static RAM the subsystems in bt_memlib.cpp may take between them.
+ * checked when bt_memlib.cpp is compiled, so growing e.g. MAX_USER_SEQ
+ * past it fails the build instead of the heap at run time.
+ */
+#define MEM_STATIC_BUDGET  (26 * 1024)
+
+typedef struct {
+  const char *name;
+  uint32_t bytes;
+  bool heap;  // allocated at run time (false: static)
+} mem_use_t;
+
+typedef struct {
+  uint32_t static_total;  // .data + .rodata + .bss, everything that isn't heap or stack
+  uint32_t heap_boot;     // free heap when mem_begin() was called
+  uint32_t heap_free;
+  uint32_t heap_low;      // lowest free heap seen by mem_service()
+  uint32_t stack_size;    // loop() stack
+  uint32_t stack_used;    // high-water mark (the core paints the stack at boot)
+} mem_stats_t;
+
+void mem_begin(void);
+void mem_service(void);
+bool mem_get_use(uint8_t idx, mem_use_t *use);
+const mem_stats_t *mem_get_stats(void);
+void mem_print(void);
+
+#endif
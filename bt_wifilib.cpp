@@ -0,0 +1,274 @@
+/*
+ * WiFi connection manager
+ * -----------------------
+ * the bssid, channel and DHCP lease of the last good connection are kept
+ * in the eeprom (see wifi_cache in bt_eepromlib.h).  a connect first tries
+ * a directed connect to that access point, which skips the scan (and, with
+ * use_lease, DHCP) and usually takes a few hundred mS.  if that doesn't
+ * work within WIFI_FAST_TIMEOUT, the credentials are tried in the
+ * wifi_source_t order, each for tries * WIFI_TICK mS, and if they all
+ * fail the whole thing starts over after a growing back off.
+ *
+ * the same sequence runs when an established connection drops, so a
+ * board that loses the access point mid-game comes back on its own.
+ * the esp's own auto-reconnect is turned off so it doesn't fight this.
+ *
+ * wifi_service() is expected to be called every time through loop().
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+#include <ESP8266WiFi.h>
+
+#include "bt_eepromlib.h"
+#include "bt_loglib.h"
+#include "bt_wifilib.h"
+
+static const char *wifi_ssid[WIFI_SRC_CNT];
+static const char *wifi_pass[WIFI_SRC_CNT];
+static int8_t wifi_tries = 10;       // ticks per credential source
+static bool wifi_use_lease = false;  // DHCP is enabled, so the cached lease may be used
+
+static wifi_state_t wifi_state = WIFI_IDLE;
+static uint32_t wifi_t_start = 0;    // millis() the connection (or reconnection) started
+static uint32_t wifi_t_state = 0;    // millis() of the last tick in this state
+static int8_t wifi_ticks = 0;
+static uint32_t wifi_backoff = WIFI_BACKOFF_MIN;
+static bool wifi_lease_set = false;  // the cached lease was configured for the directed connect
+static bool wifi_all_tried = false;
+
+static wifi_cache cache;
+static bool cache_ok = false;
+static wifi_stats_t wifi_stats = {0, 0, 0, 0, 0, 0, 0, 0, 0, -1, 0};
+
+/*
+ * are there credentials for this source
+ */
+static bool wifi_have_creds(int8_t src)  {
+  if(src == WIFI_SRC_STORED)
+    return(WiFi.SSID().length() > 0);
+  return((wifi_ssid[src] != NULL) && (strlen(wifi_ssid[src]) > 0) &&
+         ((src != WIFI_SRC_EEPROM) || (strlen(wifi_pass[src]) > 0)));
+}
+
+static void wifi_new_state(wifi_state_t state)  {
+  wifi_state = state;
+  wifi_t_state = millis();
+}
+
+/*
+ * go back to DHCP if the directed connect had the cached lease set
+ */
+static void wifi_drop_lease(void)  {
+  if(wifi_lease_set == true)  {
+    WiFi.config(0u, 0u, 0u);
+    wifi_lease_set = false;
+  }
+}
+
+/*
+ * start a normal (scanning) connect with the first source, from src on,
+ * that has credentials.  if there are none left, back off.
+ */
+static void wifi_try_from(int8_t src)  {
+  wifi_drop_lease();
+
+  for(; src < WIFI_SRC_CNT; src++)  {
+    if(wifi_have_creds(src) == false)
+      continue;
+
+    if(src == WIFI_SRC_EEPROM)  {
+      DEBUG_INFO("WiFi: using eeprom values, ssid = %s\n", wifi_ssid[src]);
+      WiFi.begin(wifi_ssid[src], wifi_pass[src]);
+    }
+    else if(src == WIFI_SRC_STORED)  {
+      DEBUG_WARNING("WARNING: WiFi: using the last known wifi (stored in nonvolatile memory)\n");
+      WiFi.begin();
+    }
+    else  {
+      DEBUG_WARNING("WARNING: WiFi: using fallback values from secrets.h, ssid = %s\n", wifi_ssid[src]);
+      WiFi.begin(wifi_ssid[src], wifi_pass[src]);
+    }
+    wifi_stats.source = src;
+    wifi_ticks = wifi_tries;
+    wifi_new_state(WIFI_TRYING);
+    return;
+  }
+
+  /*
+   * nothing worked ... stop the esp from trying and wait a while
+   */
+  DEBUG_ERROR("ERROR: WiFi: could not connect, trying again in %u mS\n", (unsigned)wifi_backoff);
+  WiFi.disconnect();
+  wifi_stats.rounds++;
+  wifi_stats.source = -1;
+  wifi_all_tried = true;
+  wifi_new_state(WIFI_BACKOFF);
+}
+
+/*
+ * directed connect to the access point in the cache.
+ * return: false if there is nothing usable cached
+ */
+static bool wifi_try_fast(void)  {
+  if((cache_ok == false) || (cache.channel == 0) || (wifi_have_creds(cache.source) == false))
+    return(false);
+
+  if((wifi_use_lease == true) && (cache.ip != 0))  {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));
+    wifi_lease_set = true;
+  }
+
+  DEBUG_INFO("WiFi: directed connect, channel %d, bssid %02x:%02x:%02x:%02x:%02x:%02x\n", cache.channel,
+             cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5]);
+  if(cache.source == WIFI_SRC_STORED)  {
+    String ssid = WiFi.SSID();
+    String pass = WiFi.psk();
+    WiFi.begin(ssid.c_str(), pass.c_str(), cache.channel, cache.bssid);
+  }
+  else
+    WiFi.begin(wifi_ssid[cache.source], wifi_pass[cache.source], cache.channel, cache.bssid);
+
+  wifi_stats.source = cache.source;
+  wifi_new_state(WIFI_FAST);
+  return(true);
+}
+
+static void wifi_connect(void)  {
+  wifi_t_start = millis();
+  if(wifi_try_fast() == false)
+    wifi_try_from(WIFI_SRC_EEPROM);
+}
+
+/*
+ * connected: update the statistics and the cache
+ */
+static void wifi_connected(void)  {
+  uint32_t ms = millis() - wifi_t_start;
+
+  wifi_stats.connects++;
+  if(wifi_state == WIFI_FAST)
+    wifi_stats.fast++;
+  wifi_stats.last_ms = ms;
+  wifi_stats.total_ms += ms;
+  if((wifi_stats.min_ms == 0) || (ms < wifi_stats.min_ms))
+    wifi_stats.min_ms = ms;
+  if(ms > wifi_stats.max_ms)
+    wifi_stats.max_ms = ms;
+  wifi_stats.channel = WiFi.channel();
+  wifi_backoff = WIFI_BACKOFF_MIN;
+
+  DEBUG_INFO("WiFi: connected at %s in %u mS\n", WiFi.localIP().toString().c_str(), (unsigned)ms);
+
+  memset(&cache, 0, sizeof(cache));
+  cache.source = wifi_stats.source;
+  cache.channel = WiFi.channel();
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.ip = (uint32_t)WiFi.localIP();
+  cache.gateway = (uint32_t)WiFi.gatewayIP();
+  cache.mask = (uint32_t)WiFi.subnetMask();
+  cache.dns = (uint32_t)WiFi.dnsIP(0);
+  eeprom_put_wifi_cache(&cache);  // only written if it changed
+  cache_ok = true;
+
+  wifi_new_state(WIFI_UP);
+}
+
+/*
+ * arguments:
+ *  ssid, pass - the eeprom credentials
+ *  fb_ssid, fb_pass - the fallback (secrets.h) credentials
+ *  tries - WIFI_TICK ticks to wait for each of the credentials (< 0 for the default)
+ *  use_lease - DHCP is enabled, so the cached lease can be used for a directed connect
+ */
+void wifi_begin(const char *ssid, const char *pass, const char *fb_ssid, const char *fb_pass, int8_t tries, bool use_lease)  {
+  wifi_ssid[WIFI_SRC_EEPROM] = ssid;
+  wifi_pass[WIFI_SRC_EEPROM] = pass;
+  wifi_ssid[WIFI_SRC_STORED] = NULL;
+  wifi_pass[WIFI_SRC_STORED] = NULL;
+  wifi_ssid[WIFI_SRC_FALLBACK] = fb_ssid;
+  wifi_pass[WIFI_SRC_FALLBACK] = fb_pass;
+  if(tries >= 0)
+    wifi_tries = tries;
+  wifi_use_lease = use_lease;
+
+  cache_ok = eeprom_get_wifi_cache(&cache);
+  if((cache_ok == true) && ((cache.source < 0) || (cache.source >= WIFI_SRC_CNT)))
+    cache_ok = false;
+
+  WiFi.setAutoReconnect(false);
+  DEBUG_INFO("Connecting to WiFi...\n");
+  wifi_connect();
+}
+
+/*
+ * run the connection state machine
+ * return: the current state
+ */
+wifi_state_t wifi_service(void)  {
+  wl_status_t status = WiFi.status();
+
+  switch(wifi_state)  {
+    case WIFI_FAST:
+      if(status == WL_CONNECTED)
+        wifi_connected();
+      else if((status == WL_NO_SSID_AVAIL) || (status == WL_CONNECT_FAILED) ||
+              ((millis() - wifi_t_state) >= WIFI_FAST_TIMEOUT))  {
+        DEBUG_WARNING("WARNING: WiFi: directed connect failed (%d), scanning\n", status);
+        wifi_stats.fast_fail++;
+        wifi_try_from(WIFI_SRC_EEPROM);
+      }
+      break;
+
+    case WIFI_TRYING:
+      if(status == WL_CONNECTED)
+        wifi_connected();
+      else if(status == WL_CONNECT_FAILED)  {  // e.g. wrong password, don't wait it out
+        DEBUG_ERROR("ERROR: WiFi: connect failed with source %d\n", wifi_stats.source);
+        wifi_try_from(wifi_stats.source + 1);
+      }
+      else if((millis() - wifi_t_state) >= WIFI_TICK)  {
+        wifi_t_state = millis();
+        if(wifi_ticks <= 0)  {
+          DEBUG_ERROR("ERROR: WiFi: timed out with source %d\n", wifi_stats.source);
+          wifi_try_from(wifi_stats.source + 1);
+        }
+        else  {
+          DEBUG_DEBUG("%d ", wifi_ticks);
+          wifi_ticks--;
+        }
+      }
+      break;
+
+    case WIFI_BACKOFF:
+      if((millis() - wifi_t_state) >= wifi_backoff)  {
+        wifi_backoff = min((uint32_t)WIFI_BACKOFF_MAX, wifi_backoff * 2);
+        wifi_connect();
+      }
+      break;
+
+    case WIFI_UP:
+      if(status != WL_CONNECTED)  {
+        DEBUG_WARNING("WARNING: WiFi: connection lost (%d), reconnecting\n", status);
+        wifi_stats.drops++;
+        wifi_connect();
+      }
+      break;
+
+    case WIFI_IDLE:
+    default:
+      break;
+  }
+  return(wifi_state);
+}
+
+/*
+ * true once connected, or once every source has been tried
+ * (boot uses this to decide when to go ahead without WiFi)
+ */
+bool wifi_tried_all(void)  {
+  return((wifi_state == WIFI_UP) || (wifi_all_tried == true));
+}
+
+const wifi_stats_t *wifi_get_stats(void)  {
+  return(&wifi_stats);
+}
@@ -0,0 +1,58 @@
+/*
+ * bt_wifilib.h
+ * ------
+ * WiFi connection manager: connects (and reconnects after a drop)
+ * in the background from loop() without blocking.
+ */
+
+#ifndef __BT_WIFILIB_H__
+#define __BT_WIFILIB_H__
+
+#include <Arduino.h>
+
+#define WIFI_TICK           500    // mS per connection attempt tick (see wifi_begin() tries)
+#define WIFI_FAST_TIMEOUT   3000   // mS for a directed connect to the cached access point
+#define WIFI_BACKOFF_MIN    5000   // mS to wait after all of the credentials failed ...
+#define WIFI_BACKOFF_MAX    60000  // ... doubling each round up to this
+
+/*
+ * where the credentials come from, in the order they are tried
+ */
+typedef enum {
+  WIFI_SRC_EEPROM = 0,  // set in eeprom
+  WIFI_SRC_STORED,      // the last good ones the esp keeps in non-volatile memory
+  WIFI_SRC_FALLBACK,    // secrets.h
+  WIFI_SRC_CNT,
+} wifi_source_t;
+
+typedef enum {
+  WIFI_IDLE = 0,
+  WIFI_FAST,      // directed connect to the cached bssid/channel
+  WIFI_TRYING,    // normal connect with one of the wifi_source_t
+  WIFI_BACKOFF,   // everything failed, waiting to start over
+  WIFI_UP,
+} wifi_state_t;
+
+/*
+ * connection counters, reported in /$netinfo
+ */
+typedef struct {
+  uint32_t connects;   // successful connections
+  uint32_t fast;       // ... of which were directed connects
+  uint32_t fast_fail;  // directed connects that had to fall back
+  uint32_t drops;      // connection lost after being up
+  uint32_t rounds;     // passes through all of the credentials that failed
+  uint32_t last_ms;    // how long the last connection took (from begin or the drop)
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint32_t total_ms;   // for the average
+  int8_t source;       // wifi_source_t in use, -1 if none
+  uint8_t channel;
+} wifi_stats_t;
+
+void wifi_begin(const char *ssid, const char *pass, const char *fb_ssid, const char *fb_pass, int8_t tries, bool use_lease);
+wifi_state_t wifi_service(void);
+bool wifi_tried_all(void);
+const wifi_stats_t *wifi_get_stats(void);
+
+#endif
@@ -1,182 +1,38 @@
-
 /*
  * data to play out on neopixels
  * built-in patterns
+ *
+ * the built-in sequences are kept in flash (PROGMEM) and read out on demand
+ * by the accessors in neo_play.cpp; only the USER slots occupy RAM.
  */
 #include "neo_data.h"
+#include "neo_gen.h"
 
+/*
+ * built-in sequences, generated at compile time (see neo_gen.h)
+ * NEO_BUILTIN(name, label, strategy, bonus, points)
+ */
+NEO_BUILTIN(red_med,     "RED-MED",     "points",  "",                                            neo_gen_pulse<16>({ 128, 0, 0, 0, 50 }));
+NEO_BUILTIN(green_med,   "GREEN-MED",   "points",  "",                                            neo_gen_pulse<16>({ 0, 128, 0, 0, 50 }));
+NEO_BUILTIN(purple_slow, "PURPLE-SLOW", "points",  "",                                            neo_gen_pulse<32>({ 128, 0, 128, 0, 50 }));
+NEO_BUILTIN(rainbow,     "RAINBOW",     "rainbow", "",                                            neo_gen_empty());
+NEO_BUILTIN(sodium,      "SODIUM",      "slowp",   "{ \"count\" : \"+6\", \"flicker\" : {\"r\": 245,  \"g\": 235,    \"b\": 76,  \"w\": 0, \"t\": 5}}",
+                                                                                                  neo_gen_ramp<1>({ 32, 22, 1, 0, 5 }, { 127, 87, 4, 0, 5 }));
 
-// adjust MAX_SEQUENCES in neo_data.h to match number initialized
-neo_data_t neo_sequences[MAX_SEQUENCES] = {
-  { "RED-MED",
-    "points",
-    {0},
-    {
-    { 0,   0, 0, 0, 50 },
-    { 8,   0, 0, 0, 50 },
-    { 16,  0, 0, 0, 50 },
-    { 24,  0, 0, 0, 50 },
-    { 32,  0, 0, 0, 50 },
-    { 40,  0, 0, 0, 50 },
-    { 48,  0, 0, 0, 50 },
-    { 56,  0, 0, 0, 50 },
-    { 64,  0, 0, 0, 50 },
-    { 72,  0, 0, 0, 50 },
-    { 80,  0, 0, 0, 50 },
-    { 88,  0, 0, 0, 50 },
-    { 96,  0, 0, 0, 50 },
-    { 104, 0, 0, 0, 50 },
-    { 112, 0, 0, 0, 50 },
-    { 120, 0, 0, 0, 50 },
-    { 128, 0, 0, 0, 50 },
-    { 128, 0, 0, 0, 50 },
-    { 120, 0, 0, 0, 50 },
-    { 112, 0, 0, 0, 50 },
-    { 104, 0, 0, 0, 50 },
-    { 96,  0, 0, 0, 50 },
-    { 88,  0, 0, 0, 50 },
-    { 80,  0, 0, 0, 50 },
-    { 72,  0, 0, 0, 50 },
-    { 64,  0, 0, 0, 50 },
-    { 56,  0, 0, 0, 50 },
-    { 48,  0, 0, 0, 50 },
-    { 40,  0, 0, 0, 50 },
-    { 32,  0, 0, 0, 50 },
-    { 24,  0, 0, 0, 50 },
-    { 16,  0, 0, 0, 50 },
-    { 8,   0, 0, 0, 50 },
-    { 0,   0, 0, 0, 50 },
-    { 0,   0, 0, 0, -1 },
-    }
-  }, // red-med
-  { "GREEN-MED",
-    "points",
-    {0},
-    {
-    { 0, 0,   0, 0, 50 },
-    { 0, 8,   0, 0, 50 },
-    { 0, 16,  0, 0, 50 },
-    { 0, 24,  0, 0, 50 },
-    { 0, 32,  0, 0, 50 },
-    { 0, 40,  0, 0, 50 },
-    { 0, 48,  0, 0, 50 },
-    { 0, 56,  0, 0, 50 },
-    { 0, 64,  0, 0, 50 },
-    { 0, 72,  0, 0, 50 },
-    { 0, 80,  0, 0, 50 },
-    { 0, 88,  0, 0, 50 },
-    { 0, 96,  0, 0, 50 },
-    { 0, 104, 0, 0, 50 },
-    { 0, 112, 0, 0, 50 },
-    { 0, 120, 0, 0, 50 },
-    { 0, 128, 0, 0, 50 },
-    { 0, 128, 0, 0, 50 },
-    { 0, 120, 0, 0, 50 },
-    { 0, 112, 0, 0, 50 },
-    { 0, 104, 0, 0, 50 },
-    { 0, 96,  0, 0, 50 },
-    { 0, 88,  0, 0, 50 },
-    { 0, 80,  0, 0, 50 },
-    { 0, 72,  0, 0, 50 },
-    { 0, 64,  0, 0, 50 },
-    { 0, 56,  0, 0, 50 },
-    { 0, 48,  0, 0, 50 },
-    { 0, 40,  0, 0, 50 },
-    { 0, 32,  0, 0, 50 },
-    { 0, 24,  0, 0, 50 },
-    { 0, 16,  0, 0, 50 },
-    { 0, 8,   0, 0, 50 },
-    { 0, 0,   0, 0, 50 },
-    { 0, 0,   0, 0, -1 },
-    }
-  }, // green-med
-  { "PURPLE-SLOW",
-    "points",
-    {0},
-    {
-    { 0,   0, 0,   0, 50 },
-    { 4,   0, 4,   0, 50 },
-    { 8,   0, 8,   0, 50 },
-    { 12,  0, 12,  0, 50 },
-    { 16,  0, 16,  0, 50 },
-    { 20,  0, 20,  0, 50 },
-    { 24,  0, 24,  0, 50 },
-    { 32,  0, 32,  0, 50 },
-    { 40,  0, 40,  0, 50 },
-    { 44,  0, 44,  0, 50 },
-    { 48,  0, 48,  0, 50 },
-    { 52,  0, 52,  0, 50 },
-    { 56,  0, 56,  0, 50 },
-    { 60,  0, 60,  0, 50 },
-    { 64,  0, 64,  0, 50 },
-    { 68,  0, 68,  0, 50 },
-    { 72,  0, 72,  0, 50 },
-    { 76,  0, 76,  0, 50 },
-    { 80,  0, 80,  0, 50 },
-    { 84,  0, 84,  0, 50 },
-    { 88,  0, 88,  0, 50 },
-    { 92,  0, 92,  0, 50 },
-    { 96,  0, 96,  0, 50 },
-    { 100, 0, 100, 0, 50 },
-    { 104, 0, 104, 0, 50 },
-    { 108, 0, 108, 0, 50 },
-    { 112, 0, 112, 0, 50 },
-    { 116, 0, 116, 0, 50 },
-    { 120, 0, 120, 0, 50 },
-    { 124, 0, 124, 0, 50 },
-    { 128, 0, 128, 0, 50 },
-    { 128, 0, 128, 0, 50 },
-    { 124, 0, 124, 0, 50 },
-    { 120, 0, 120, 0, 50 },
-    { 116, 0, 116, 0, 50 },
-    { 112, 0, 112, 0, 50 },
-    { 108, 0, 108, 0, 50 },
-    { 104, 0, 104, 0, 50 },
-    { 100, 0, 100, 0, 50 },
-    { 96,  0, 96,  0, 50 },
-    { 92,  0, 92,  0, 50 },
-    { 88,  0, 88,  0, 50 },
-    { 84,  0, 84,  0, 50 },
-    { 80,  0, 80,  0, 50 },
-    { 76,  0, 76,  0, 50 },
-    { 72,  0, 72,  0, 50 },
-    { 68,  0, 68,  0, 50 },
-    { 64,  0, 64,  0, 50 },
-    { 60,  0, 60,  0, 50 },
-    { 56,  0, 56,  0, 50 },
-    { 52,  0, 52,  0, 50 },
-    { 48,  0, 48,  0, 50 },
-    { 44,  0, 44,  0, 50 },
-    { 40,  0, 40,  0, 50 },
-    { 36,  0, 36,  0, 50 },
-    { 32,  0, 32,  0, 50 },
-    { 28,  0, 28,  0, 50 },
-    { 24,  0, 24,  0, 50 },
-    { 20,  0, 20,  0, 50 },
-    { 16,  0, 16,  0, 50 },
-    { 12,  0, 12,  0, 50 },
-    { 8,   0, 8,   0, 50 },
-    { 4,   0, 4,   0, 50 },
-    { 0,   0, 0,   0, 50 },
-    { 0,   0, 0,   0, -1},
-    }
-  }, //purple-slow
-  { "RAINBOW",
-    "rainbow",
-    {0},
-    {
-      { 0, 0, 0, 0, -1 },
-    }
-  }, // rainbow
-  { "SODIUM",
-    "slowp",
-    "{ \"count\" : \"+6\", \"flicker\" : {\"r\": 245,  \"g\": 235,    \"b\": 76,  \"w\": 0, \"t\": 5}}",
-    {
-      { 32,  22,   1,  0,  5},
-      { 127, 87,   4,  0,  5},
-      { 0,   0,    0,  0, -1}
-    }
-  }, // sodium
+// adjust NEO_BUILTIN_SEQ in neo_data.h to match number initialized
+const neo_builtin_t neo_builtins[NEO_BUILTIN_SEQ] PROGMEM = {
+  NEO_BUILTIN_ENTRY(red_med),
+  NEO_BUILTIN_ENTRY(green_med),
+  NEO_BUILTIN_ENTRY(purple_slow),
+  NEO_BUILTIN_ENTRY(rainbow),
+  NEO_BUILTIN_ENTRY(sodium),
+};
+
+/*
+ * RAM slots for the sequences loaded from user files
+ * adjust MAX_USER_SEQ in neo_data.h to match number initialized
+ */
+neo_data_t neo_sequences[MAX_USER_SEQ] = {
   { "USER-1",
     {0},
     {0},
@@ -212,4 +68,11 @@ neo_data_t neo_sequences[MAX_SEQUENCES] = {
       { 0, 0, 0, 0, -1 },
     }
   }, // user-5
-};
\ No newline at end of file
+  { NEO_SCRATCH_LABEL,
+    {0},
+    {0},
+    {
+      { 0, 0, 0, 0, -1 },
+    }
+  }, // scratch: written by neo_play_json(), never from a file
+};
@@ -7,12 +7,16 @@
 #include <c_types.h>
 #include <Adafruit_NeoPixel.h>
 
-#define NEO_SEQ_STRATEGIES 6
-#define MAX_USER_SEQ       5      // maximum number of user buttons/files
-#define MAX_SEQUENCES      10     // number of sequences to allocate
+#define NEO_SEQ_STRATEGIES 7
+#define NEO_BUILTIN_SEQ    5      // number of built-in sequences (in flash)
+#define MAX_USER_SEQ       6      // RAM slots for sequence files + the scratch slot
+#define MAX_SEQUENCES      (NEO_BUILTIN_SEQ + MAX_USER_SEQ)  // total selectable sequences
 #define MAX_NUM_SEQ_POINTS 256    // maximum number of points per sequence
 #define MAX_NEO_BONUS      128     // max chars  in strategy bonus
 #define MAX_NEO_STRATEGY   16     // max chars in a strategy string
+#define MAX_NEO_LABEL      32     // max chars in a sequence label (when copied out)
+#define MAX_NEO_FILE       1024   // max chars in a sequence file/document
+#define NEO_SCRATCH_LABEL  "SCRATCH"  // slot for sequences played straight from the web page
 #define NEO_SLOWP_POINTS   1024   // number of points (smoothness) in SLOWP sequence
 #define NEO_SLOWP_FLICKERS 100    // max number of slowp random flickers
 #define NEO_FLICKER_MAX    255    // value for bright flickers
@@ -20,6 +24,12 @@
 
 #define NEO_UPDATE_INTERVAL 2000  // neopixel strand update rate in uS
 
+/*
+ * temporal dithering of the 16 bit colors (see neo_play.cpp)
+ */
+#define NEO_DITHER_MIN_HZ  100    // refreshing slower than this flickers, so it's not dithered
+#define NEO_DITHER_DUTY    4      // show() may take at most 1/4 of the time between frames
+
 /*
  * return error codes for reading a user sequence file
  * and maybe other functions
@@ -51,12 +61,23 @@ typedef struct {
 } neo_seq_point_t;
 
 typedef struct  {
-  const char *label;
+  char label[MAX_NEO_LABEL];  // a slot takes the label of the file loaded into it
   char strategy[MAX_NEO_STRATEGY];
   char bonus[MAX_NEO_BONUS];
   neo_seq_point_t point[MAX_NUM_SEQ_POINTS];
 } neo_data_t;
 
+/*
+ * built-in sequences: the table and everything it points to
+ * lives in flash (PROGMEM) and must be read with memcpy_P()/pgm_read_*()
+ */
+typedef struct  {
+  const char *label;
+  const char *strategy;
+  const char *bonus;
+  const neo_seq_point_t *point;
+} neo_builtin_t;
+
 /*
  * how should the contents of the sequence file be interpreted
  * an played out
@@ -68,6 +89,7 @@ typedef enum {
   SEQ_STRAT_PONG,     // attributes of single moving pixel are specified
   SEQ_STRAT_RAINBOW,  // attributes of a dynamic rainbow pattern are specified
   SEQ_STRAT_SLOWP,    // slow pulse - calculated sequence
+  SEQ_STRAT_STREAM,   // per-pixel animation played from a file
   SEQ_STRAT_UNDEFINED
 }  seq_strategy_t;
 
@@ -100,16 +122,30 @@ void neo_cycle_next(void);
 void neo_init(uint16_t numPixels, int16_t pin, neoPixelType pixelFormat);
 int8_t neo_is_user(const char *label);
 int8_t neo_load_sequence(const char *file);
+int8_t neo_play_json(const char *json, size_t len);
 int8_t neo_set_sequence(const char *label, const char *strategy);
 seq_strategy_t neo_set_strategy(const char *sstrategy);
 void neo_cycle_stop(void);
+void neo_restart(void);
+void neo_stream_release(void);
 void neo_n_blinks(uint8_t r, uint8_t g, uint8_t b, int8_t reps, int32_t t);
+void neo_fill(uint8_t r, uint8_t g, uint8_t b);
 void neo_set_gamma_color(bool gamma_enable);
+neo_seq_point_t neo_get_point(int8_t idx, int32_t pt);
+void neo_get_strategy(int8_t idx, char *buf);
+void neo_get_bonus(int8_t idx, char *buf);
+int8_t neo_get_playing(char *buf);
+void neo_set_brightness(uint8_t brightness);
+uint32_t neo_heap_bytes(void);
 
 /*
- * array of neopixel sequences and the index to the currently playing one
+ * built-in sequences (flash) followed by the user sequences (RAM)
+ * and the index to the currently playing one.
+ * seq_index 0 .. NEO_BUILTIN_SEQ-1 selects neo_builtins[],
+ * the rest select neo_sequences[seq_index - NEO_BUILTIN_SEQ].
  */
-extern neo_data_t neo_sequences[MAX_SEQUENCES];  // sequence specifications
+extern const neo_builtin_t neo_builtins[NEO_BUILTIN_SEQ];  // built-in specifications
+extern neo_data_t neo_sequences[MAX_USER_SEQ];  // user sequence specifications
 extern int8_t seq_index;  // which sequence is being played out
 extern int8_t strategy_idx; // which strategy should be used to play a user file
 
@@ -0,0 +1,124 @@
+/*
+ * compile-time generators for the built-in point sequences
+ *
+ * each generator is a constexpr function that returns a fixed size
+ * neo_points_t<N> (N is worked out from the template parameters), so
+ * a built-in is declared in one line and the compiler places the finished
+ * points straight into flash:
+ *
+ *   static constexpr auto red_points PROGMEM = neo_gen_pulse<16>({ 128, 0, 0, 0, 50 });
+ *
+ * colors are given as neo_seq_point_t; the ms_after_last member is the
+ * time each generated point is held.  every generated array ends with the
+ * usual ms_after_last = -1 terminator.
+ */
+#ifndef __NEO_GEN_H__
+
+#include "neo_data.h"
+
+/*
+ * fixed size array of points that a constexpr function can fill in
+ */
+template <uint16_t N>
+struct neo_points_t {
+  static_assert(N <= MAX_NUM_SEQ_POINTS, "generated sequence is longer than MAX_NUM_SEQ_POINTS");
+  neo_seq_point_t point[N];
+};
+
+/*
+ * one channel of a linear interpolation: step i of steps from a to b
+ */
+constexpr uint8_t neo_gen_lerp(uint8_t a, uint8_t b, uint16_t i, uint16_t steps)  {
+  return((uint8_t)(a + ((int32_t)(b - a) * i) / steps));
+}
+
+constexpr neo_seq_point_t neo_gen_mix(const neo_seq_point_t &a, const neo_seq_point_t &b, uint16_t i, uint16_t steps, int32_t ms)  {
+  return(neo_seq_point_t{ neo_gen_lerp(a.red, b.red, i, steps),
+                          neo_gen_lerp(a.green, b.green, i, steps),
+                          neo_gen_lerp(a.blue, b.blue, i, steps),
+                          neo_gen_lerp(a.white, b.white, i, steps),
+                          ms });
+}
+
+constexpr neo_seq_point_t neo_gen_terminator(void)  {
+  return(neo_seq_point_t{ 0, 0, 0, 0, -1 });
+}
+
+/*
+ * nothing but the terminator (e.g. for calculated strategies like rainbow)
+ */
+constexpr neo_points_t<1> neo_gen_empty(void)  {
+  neo_points_t<1> seq{};
+  seq.point[0] = neo_gen_terminator();
+  return(seq);
+}
+
+/*
+ * ramp: STEPS+1 points from "from" to "to" inclusive.
+ * points are held for from.ms_after_last, except the last one, which
+ * takes to.ms_after_last.  with STEPS = 1 this is just the two endpoints
+ * (what slowp and pong expect).
+ */
+template <uint16_t STEPS>
+constexpr neo_points_t<STEPS + 2> neo_gen_ramp(const neo_seq_point_t &from, const neo_seq_point_t &to)  {
+  neo_points_t<STEPS + 2> seq{};
+  for(uint16_t i = 0; i < STEPS; i++)
+    seq.point[i] = neo_gen_mix(from, to, i, STEPS, from.ms_after_last);
+  seq.point[STEPS] = to;
+  seq.point[STEPS + 1] = neo_gen_terminator();
+  return(seq);
+}
+
+/*
+ * pulse: ramp up from off to peak in STEPS, hold the peak for one more
+ * point and ramp back down to off, all at peak.ms_after_last per point.
+ */
+template <uint16_t STEPS>
+constexpr neo_points_t<2 * STEPS + 3> neo_gen_pulse(const neo_seq_point_t &peak)  {
+  neo_points_t<2 * STEPS + 3> seq{};
+  const neo_seq_point_t off = { 0, 0, 0, 0, peak.ms_after_last };
+
+  for(uint16_t i = 0; i <= STEPS; i++)  {
+    seq.point[i] = neo_gen_mix(off, peak, i, STEPS, peak.ms_after_last);
+    seq.point[2 * STEPS + 1 - i] = seq.point[i];
+  }
+  seq.point[2 * STEPS + 2] = neo_gen_terminator();
+  return(seq);
+}
+
+/*
+ * palette cycle: hold each of the K colors for its own ms_after_last,
+ * then cross-fade to the next one (wrapping to the first) in FADE
+ * steps of fade_ms each.  FADE = 0 gives hard cuts.
+ */
+template <uint16_t FADE, uint16_t K>
+constexpr neo_points_t<K * (FADE + 1) + 1> neo_gen_cycle(const neo_seq_point_t (&colors)[K], int32_t fade_ms)  {
+  neo_points_t<K * (FADE + 1) + 1> seq{};
+  uint16_t n = 0;
+
+  for(uint16_t k = 0; k < K; k++)  {
+    seq.point[n++] = colors[k];
+    for(uint16_t i = 1; i <= FADE; i++)
+      seq.point[n++] = neo_gen_mix(colors[k], colors[(k + 1) % K], i, FADE + 1, fade_ms);
+  }
+  seq.point[n] = neo_gen_terminator();
+  return(seq);
+}
+
+/*
+ * declare everything a built-in needs in flash in one line.
+ * the points are the last (variadic) argument so that commas inside
+ * template argument lists don't upset the preprocessor.
+ * NEO_BUILTIN_ENTRY(name) is the matching neo_builtins[] initializer.
+ */
+#define NEO_BUILTIN(name, label, strategy, bonus, ...)                \
+  static const char name##_label[] PROGMEM = label;                   \
+  static const char name##_strategy[] PROGMEM = strategy;             \
+  static const char name##_bonus[] PROGMEM = bonus;                   \
+  static constexpr auto name##_points PROGMEM = __VA_ARGS__
+
+#define NEO_BUILTIN_ENTRY(name) \
+  { name##_label, name##_strategy, name##_bonus, name##_points.point }
+
+#define __NEO_GEN_H__
+#endif
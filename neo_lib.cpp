@@ -0,0 +1,160 @@
+/*
+ * index of the sequence files in LittleFS
+ *
+ * each file is parsed once, as a stream and through a filter, so only
+ * the label, the strategy and a stub per point are ever held in RAM.
+ * labels are hashed (FNV-1a) into lib_hash[] with linear probing, so
+ * finding the file for a button press doesn't depend on how many
+ * files there are and never goes to the flash.
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include "bt_fsio.h"
+#include "bt_jsonpool.h"
+#include "bt_loglib.h"
+#include "neo_data.h"
+#include "neo_lib.h"
+
+static_assert((NEO_LIB_HASH & (NEO_LIB_HASH - 1)) == 0, "NEO_LIB_HASH must be a power of 2");
+
+static neo_lib_entry_t lib_index[NEO_LIB_MAX];
+static uint8_t lib_count = 0;
+static int8_t lib_hash[NEO_LIB_HASH];  // index into lib_index[], -1 if empty
+static volatile bool lib_dirty = false;
+
+static uint8_t lib_hash_label(const char *label)  {
+  uint32_t h = 2166136261u;
+
+  while(*label != '\0')  {
+    h ^= (uint8_t)*label++;
+    h *= 16777619u;
+  }
+  return(h & (NEO_LIB_HASH - 1));
+}
+
+/*
+ * add lib_index[idx] to the hash table
+ * return: false if the label is already there (first file wins)
+ */
+static bool lib_hash_add(uint8_t idx)  {
+  uint8_t h = lib_hash_label(lib_index[idx].label);
+
+  while(lib_hash[h] >= 0)  {
+    if(strcmp(lib_index[lib_hash[h]].label, lib_index[idx].label) == 0)
+      return(false);
+    h = (h + 1) & (NEO_LIB_HASH - 1);
+  }
+  lib_hash[h] = idx;
+  return(true);
+}
+
+/*
+ * pick the index information out of one file
+ * return: true if it is a sequence
+ */
+static bool lib_read_entry(File &fd, neo_lib_entry_t *entry)  {
+  JsonDocument doc(json_pool()), filter(json_pool());
+  DeserializationError err;
+  const char *label;
+  uint32_t t = micros();
+
+  filter["label"] = true;
+  filter["strategy"] = true;
+  filter["points"][0]["t"] = true;  // just enough to count them
+
+  err = deserializeJson(doc, fd, DeserializationOption::Filter(filter));
+  fsio_note_read(FSIO_SEQ_INDEX, fd.position(), t);
+  if(err)  {
+    DEBUG_WARNING("WARNING: neo_lib: %s: %s ... not indexed\n", fd.name(), err.c_str());
+    return(false);
+  }
+  if((label = doc["label"]) == NULL)
+    return(false);
+
+  strncpy(entry->label, label, sizeof(entry->label) - 1);
+  entry->label[sizeof(entry->label) - 1] = '\0';
+  strncpy(entry->strategy, doc["strategy"] | "points", sizeof(entry->strategy) - 1);
+  entry->strategy[sizeof(entry->strategy) - 1] = '\0';
+  entry->points = doc["points"].size();
+  entry->size = fd.size();
+  return(true);
+}
+
+/*
+ * rebuild the index from the files in the root of the file system
+ */
+void neo_lib_scan(void)  {
+  Dir dir = LittleFS.openDir("/");
+  uint32_t start = millis();
+  neo_lib_entry_t *entry;
+  File fd;
+
+  lib_dirty = false;
+  lib_count = 0;
+  memset(lib_hash, -1, sizeof(lib_hash));
+
+  while(dir.next())  {
+    if(!dir.isFile() || !dir.fileName().endsWith(".json"))
+      continue;
+    if(lib_count >= NEO_LIB_MAX)  {
+      DEBUG_ERROR("ERROR: neo_lib: more than %d sequence files, %s and later not indexed\n", NEO_LIB_MAX, dir.fileName().c_str());
+      break;
+    }
+    if(dir.fileName().length() >= (NEO_LIB_FILE - 1))  {
+      DEBUG_WARNING("WARNING: neo_lib: file name %s is too long ... not indexed\n", dir.fileName().c_str());
+      continue;
+    }
+
+    entry = &lib_index[lib_count];
+    if(!(fd = fsio_open(FSIO_SEQ_INDEX, dir, "r")))
+      continue;
+    if(lib_read_entry(fd, entry) == true)  {
+      snprintf(entry->file, sizeof(entry->file), "/%s", dir.fileName().c_str());
+      if(lib_hash_add(lib_count) == true)
+        lib_count++;
+      else
+        DEBUG_WARNING("WARNING: neo_lib: %s has the same label as another file (%s) ... not indexed\n", entry->file, entry->label);
+    }
+    fsio_close(FSIO_SEQ_INDEX, fd);
+  }
+  DEBUG_INFO("neo_lib: %d sequence files indexed in %u mS\n", lib_count, (unsigned)(millis() - start));
+}
+
+/*
+ * the files changed, rescan from loop() rather than in a server callback
+ */
+void neo_lib_invalidate(void)  {
+  lib_dirty = true;
+}
+
+void neo_lib_service(void)  {
+  if(lib_dirty == true)
+    neo_lib_scan();
+}
+
+uint8_t neo_lib_count(void)  {
+  return(lib_count);
+}
+
+const neo_lib_entry_t *neo_lib_get(uint8_t idx)  {
+  return((idx < lib_count) ? &lib_index[idx] : NULL);
+}
+
+/*
+ * return: the entry with this label, or NULL if there isn't one
+ */
+const neo_lib_entry_t *neo_lib_find(const char *label)  {
+  uint8_t h = lib_hash_label(label);
+
+  if(lib_count == 0)  // also covers before the first scan
+    return(NULL);
+  for(uint8_t n = 0; (n < NEO_LIB_HASH) && (lib_hash[h] >= 0); n++)  {
+    if(strcmp(lib_index[lib_hash[h]].label, label) == 0)
+      return(&lib_index[lib_hash[h]]);
+    h = (h + 1) & (NEO_LIB_HASH - 1);
+  }
+  return(NULL);
+}
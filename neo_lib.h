@@ -0,0 +1,34 @@
+/*
+ * index of the sequence files in LittleFS
+ *
+ * every .json file in the root directory with a "label" is a sequence.  the index is built
+ * once at boot and again after an upload/delete (from loop(), see
+ * neo_lib_service()), served by /api/sequences for the button page and
+ * used to go from a label to its file without touching the flash.
+ */
+#ifndef __NEO_LIB_H__
+
+#include <c_types.h>
+#include "neo_data.h"
+
+#define NEO_LIB_MAX    16               // sequence files indexed
+#define NEO_LIB_FILE   32               // max chars in a file name (LittleFS allows 31)
+#define NEO_LIB_HASH   (2 * NEO_LIB_MAX)  // label hash table slots (power of 2)
+
+typedef struct {
+  char label[MAX_NEO_LABEL];
+  char file[NEO_LIB_FILE];
+  char strategy[MAX_NEO_STRATEGY];
+  uint32_t size;    // bytes
+  uint16_t points;  // number of points in the file
+} neo_lib_entry_t;
+
+void neo_lib_scan(void);
+void neo_lib_invalidate(void);
+void neo_lib_service(void);
+uint8_t neo_lib_count(void);
+const neo_lib_entry_t *neo_lib_get(uint8_t idx);
+const neo_lib_entry_t *neo_lib_find(const char *label);
+
+#define __NEO_LIB_H__
+#endif
@@ -0,0 +1,316 @@
+/*
+ * pixel writers
+ * -------------
+ * Adafruit_NeoPixel::setPixelColor() works out the byte order and checks
+ * the index and the brightness for every pixel it is given.  here the pixel
+ * type is a template parameter, so each type gets its own writers with the
+ * byte offsets (and whether there's a white byte) as constants.  gamma and
+ * brightness are folded into one 256 entry table that each channel is
+ * looked up in, or left out altogether at full brightness without gamma.
+ *
+ * a pixel is put together as a word, first byte in the low bits, and
+ * stored with word writes: one per pixel with white, three for every four
+ * pixels without.  the strand buffer is malloc'ed, so it is word aligned.
+ *
+ * the scaling is the library's, (v * (brightness + 1)) >> 8, so
+ * pixels->setBrightness() still rescales what is already in the buffer
+ * the same way.
+ *
+ * 16 bit colors (neo_color16_t) go through the same gamma curve, calculated
+ * at 16 bits instead of looked up at 8, so the dim end keeps its fractions.
+ * for temporal dithering each byte of the strand buffer has an 8 bit
+ * accumulator (in the same order, so the kernel walks both buffers straight
+ * through): the channel's fraction is added every frame and the carry out
+ * of it bumps that frame's byte, so over 256 frames each pixel averages the
+ * 16 bit value.  the accumulators start out spread, so neighbouring pixels
+ * don't all step up in the same frame.
+ */
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+#include "neo_pixel.h"
+
+#define PX_GAMMA     0  // px_level[PX_GAMMA]: gamma and brightness
+#define PX_BRIGHT    1  // px_level[PX_BRIGHT]: brightness only
+#define PX_STRAIGHT  2  // no table
+#define PX_LEVELS    3
+
+#define PX_GAMMA_EXP  2.6  // same curve as the library's gamma8()/gamma32()
+
+static uint8_t px_level[2][256];
+
+template<uint8_t T, uint8_t L>
+struct px_writer  {
+  static const uint8_t W = (T >> 6) & 3, R = (T >> 4) & 3, G = (T >> 2) & 3, B = T & 3;
+  static const uint8_t BPP = (W == R) ? 3 : 4;  // the RGB types have white at the red offset
+
+  static inline uint32_t level(uint32_t v)  {
+    return((L == PX_STRAIGHT) ? (v & 0xFF) : px_level[(L == PX_STRAIGHT) ? 0 : L][v & 0xFF]);
+  }
+
+  /*
+   * packed color to the pixel's bytes, corrected
+   */
+  static inline uint32_t word(uint32_t c)  {
+    uint32_t w = (level(c >> 16) << (R * 8)) | (level(c >> 8) << (G * 8)) | (level(c) << (B * 8));
+
+    if(BPP == 4)
+      w |= level(c >> 24) << (W * 8);
+    return(w);
+  }
+
+  static inline void store(uint8_t *buf, uint32_t i, uint32_t w)  {
+    if(BPP == 4)
+      ((uint32_t *)buf)[i] = w;
+    else  {
+      buf += i * 3;
+      buf[0] = w;
+      buf[1] = w >> 8;
+      buf[2] = w >> 16;
+    }
+  }
+
+  /*
+   * pixels first .. first + n - 1 from src(0) .. src(n - 1), which
+   * return the pixel's bytes.  without white a pixel on a multiple
+   * of 4 starts on a word, so it's bytes up to there, then words.
+   */
+  template<class S>
+  static inline void write(uint8_t *buf, uint16_t first, uint16_t n, S &src)  {
+    uint32_t i = first, end = (uint32_t)first + n;
+    uint32_t w0, w1, w2, w3, *p;
+
+    if(BPP == 4)  {
+      for(p = (uint32_t *)buf; i < end; i++)
+        p[i] = src(i - first);
+      return;
+    }
+    for(; (i < end) && ((i & 3) != 0); i++)
+      store(buf, i, src(i - first));
+    for(p = (uint32_t *)(buf + (i * 3)); (i + 4) <= end; i += 4, p += 3)  {
+      w0 = src(i - first);
+      w1 = src(i + 1 - first);
+      w2 = src(i + 2 - first);
+      w3 = src(i + 3 - first);
+      p[0] = w0 | (w1 << 24);
+      p[1] = (w1 >> 8) | (w2 << 16);
+      p[2] = (w2 >> 16) | (w3 << 8);
+    }
+    for(; i < end; i++)
+      store(buf, i, src(i - first));
+  }
+
+  static void fill(uint8_t *buf, uint16_t n, uint32_t color)  {
+    uint32_t w = word(color);
+    auto src = [w](uint32_t) { return(w); };
+    write(buf, 0, n, src);
+  }
+
+  static void put(uint8_t *buf, uint16_t i, uint32_t color)  {
+    store(buf, i, word(color));
+  }
+
+  static void rgb(uint8_t *buf, uint16_t first, uint16_t n, const uint8_t *rgb)  {
+    auto src = [rgb](uint32_t i) {
+      const uint8_t *p = rgb + (i * 3);
+      return(word(((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]));
+    };
+    write(buf, first, n, src);
+  }
+
+  static void lut8(uint8_t *buf, uint16_t n, const uint8_t *idx, uint8_t add, const uint32_t *lut)  {
+    auto src = [idx, add, lut](uint32_t i) { return(word(lut[(uint8_t)(idx[i] + add)])); };
+    write(buf, 0, n, src);
+  }
+
+  static void lut4(uint8_t *buf, uint16_t n, const uint8_t *idx, const uint32_t *lut)  {
+    auto src = [idx, lut](uint32_t i) {
+      return(word(lut[(i & 1) ? (idx[i >> 1] & 0x0F) : (idx[i >> 1] >> 4)]));
+    };
+    write(buf, 0, n, src);
+  }
+
+  static const neo_px_t ops;
+};
+
+template<uint8_t T, uint8_t L>
+const neo_px_t px_writer<T, L>::ops = { BPP, fill, put, rgb, lut8, lut4 };
+
+/*
+ * the pixel types that have writers, the first is the default
+ */
+struct px_type  {
+  uint8_t type;
+  const neo_px_t *ops[PX_LEVELS];
+};
+
+#define PX_TYPE(t)  { (t), { &px_writer<(t), PX_GAMMA>::ops, &px_writer<(t), PX_BRIGHT>::ops, &px_writer<(t), PX_STRAIGHT>::ops } }
+
+static const px_type px_types[] = {
+  PX_TYPE(NEO_GRB),
+  PX_TYPE(NEO_RGB),
+  PX_TYPE(NEO_GRBW),
+  PX_TYPE(NEO_RGBW),
+};
+#define PX_TYPES  (sizeof(px_types) / sizeof(px_type))
+
+const neo_px_t *neo_px = &px_writer<NEO_GRB, PX_STRAIGHT>::ops;
+const neo_px_t *neo_px_nogamma = &px_writer<NEO_GRB, PX_STRAIGHT>::ops;
+
+static const px_type *px_sel = &px_types[0];  // as picked by neo_px_select()
+static bool px_sel_gamma = false;
+static uint16_t px_scale = 256;               // brightness + 1
+
+static uint16_t *px_gamma16 = NULL;  // 8.8 gamma curve at each whole input, made on first use
+static uint8_t *px_acc = NULL;       // dithering accumulators, one for each byte of the strand
+static uint16_t px_acc_pixels = 0;
+static neo_color16_t px_color16;     // the last neo_px_fill16() color
+
+/*
+ * pick the writers for the strand's pixel type and fill in the tables
+ * (again whenever the gamma or brightness setting changes)
+ * return: false if the type has no writers (the default ones are used)
+ */
+bool neo_px_select(neoPixelType type, bool gamma, uint8_t brightness)  {
+  const px_type *t = &px_types[0];
+  uint16_t scale = (uint16_t)brightness + 1;
+  bool ret = false;
+
+  for(uint8_t i = 0; i < PX_TYPES; i++)  {
+    if(px_types[i].type == (type & 0xFF))  {
+      t = &px_types[i];
+      ret = true;
+    }
+  }
+
+  for(uint16_t v = 0; v < 256; v++)  {
+    px_level[PX_GAMMA][v] = ((uint16_t)Adafruit_NeoPixel::gamma8(v) * scale) >> 8;
+    px_level[PX_BRIGHT][v] = (v * scale) >> 8;
+  }
+
+  neo_px_nogamma = t->ops[(brightness == 255) ? PX_STRAIGHT : PX_BRIGHT];
+  neo_px = gamma ? t->ops[PX_GAMMA] : neo_px_nogamma;
+
+  px_sel = t;
+  px_sel_gamma = gamma;
+  px_scale = scale;
+  return(ret);
+}
+
+/*
+ * one 8.8 channel corrected (gamma between the whole steps is linear)
+ */
+static uint16_t px_level16(uint16_t v)  {
+  uint8_t i = v >> 8, f = v;
+
+  if(px_sel_gamma && (px_gamma16 != NULL))
+    v = px_gamma16[i] + ((((int32_t)px_gamma16[i + 1] - px_gamma16[i]) * f) >> 8);
+  return(((uint32_t)v * px_scale) >> 8);
+}
+
+/*
+ * the corrected channels of px_color16 in strand order
+ * return: false if they are all whole (nothing to dither)
+ */
+static bool px_target16(uint16_t *t)  {
+  uint8_t type = px_sel->type;
+  uint8_t bpp = px_sel->ops[PX_STRAIGHT]->bpp;
+  uint16_t frac = 0;
+
+  t[(type >> 4) & 3] = px_level16(px_color16.red);
+  t[(type >> 2) & 3] = px_level16(px_color16.green);
+  t[type & 3] = px_level16(px_color16.blue);
+  if(bpp == 4)
+    t[(type >> 6) & 3] = px_level16(px_color16.white);
+  for(uint8_t c = 0; c < bpp; c++)
+    frac |= t[c] & 0xFF;
+  return(frac != 0);
+}
+
+/*
+ * the dither kernel: n pixels of BPP bytes, each channel its target
+ * plus the carry out of its accumulator
+ */
+template<uint8_t BPP>
+static void px_dither_run(uint8_t *buf, uint8_t *acc, uint16_t n, const uint16_t *t)  {
+  uint16_t s;
+
+  for(uint16_t i = 0; i < n; i++, buf += BPP, acc += BPP)  {
+    for(uint8_t c = 0; c < BPP; c++)  {
+      s = t[c] + acc[c];  // t is at most 0xFF00, so this can't overflow
+      buf[c] = s >> 8;
+      acc[c] = s;
+    }
+  }
+}
+
+/*
+ * set up dithering for a strand of n pixels (in the type last selected)
+ * return: false if there's no memory for it
+ */
+bool neo_px_dither_begin(uint16_t n)  {
+  uint32_t bytes = (uint32_t)n * px_sel->ops[PX_STRAIGHT]->bpp;
+
+  free(px_acc);
+  px_acc_pixels = 0;
+  if((px_acc = (uint8_t *)malloc(bytes)) == NULL)
+    return(false);
+  for(uint32_t j = 0; j < bytes; j++)
+    px_acc[j] = j * 167;  // spread the phases (any odd step does)
+  px_acc_pixels = n;
+  return(true);
+}
+
+uint32_t neo_px_dither_bytes(void)  {
+  return(((px_acc != NULL) ? (px_acc_pixels * px_sel->ops[PX_STRAIGHT]->bpp) : 0) +
+         ((px_gamma16 != NULL) ? (257 * sizeof(uint16_t)) : 0));
+}
+
+/*
+ * n pixels from the start of the strand set to a 16 bit color, dithered
+ * if asked (and set up by neo_px_dither_begin()), otherwise rounded
+ * return: true if the frame is dithered and has to be refreshed with
+ * neo_px_dither() to show the fractions
+ */
+bool neo_px_fill16(uint8_t *buf, uint16_t n, const neo_color16_t *color, bool dither)  {
+  uint16_t t[4] = {0, 0, 0, 0};
+
+  if(px_sel_gamma && (px_gamma16 == NULL))  {
+    if((px_gamma16 = (uint16_t *)malloc(257 * sizeof(uint16_t))) != NULL)  {
+      for(uint16_t i = 0; i < 256; i++)
+        px_gamma16[i] = (uint16_t)(powf(i / 255.0f, PX_GAMMA_EXP) * 0xFF00 + 0.5f);
+      px_gamma16[256] = 0xFF00;  // only ever weighted by 0
+    }
+  }
+
+  px_color16 = *color;
+  if(dither && (px_acc != NULL) && (n <= px_acc_pixels))
+    return(neo_px_dither(buf, n));
+
+  px_target16(t);
+  for(uint8_t c = 0; c < 4; c++)
+    t[c] = (t[c] + 0x80) >> 8;
+  px_sel->ops[PX_STRAIGHT]->fill(buf, n, Adafruit_NeoPixel::Color(t[(px_sel->type >> 4) & 3],
+                                                                  t[(px_sel->type >> 2) & 3],
+                                                                  t[px_sel->type & 3],
+                                                                  t[(px_sel->type >> 6) & 3]));
+  return(false);
+}
+
+/*
+ * the next frame of the last neo_px_fill16() color (with the brightness
+ * and gamma as they are now)
+ * return: false if there's nothing to dither (every frame is the same)
+ */
+bool neo_px_dither(uint8_t *buf, uint16_t n)  {
+  uint16_t t[4];
+  bool frac = px_target16(t);
+
+  if((px_acc == NULL) || (n > px_acc_pixels))
+    return(false);
+  if(px_sel->ops[PX_STRAIGHT]->bpp == 4)
+    px_dither_run<4>(buf, px_acc, n, t);
+  else
+    px_dither_run<3>(buf, px_acc, n, t);
+  return(frac);
+}
@@ -0,0 +1,67 @@
+/*
+ * pixel writers that go straight into the strand buffer (getPixels())
+ *
+ * there's one set for each color order and correction, built from a
+ * template in neo_pixel.cpp, and the one to use is picked once by
+ * neo_px_select() (pixel type from the eeprom, gamma and brightness).
+ * colors are given as Adafruit packed colors (0xWWRRGGBB, see
+ * Adafruit_NeoPixel::Color()) and come out corrected and in strand order.
+ */
+#ifndef __NEO_PIXEL_H__
+
+#include <c_types.h>
+#include <Adafruit_NeoPixel.h>
+
+typedef struct {
+  uint8_t bpp;  // bytes per pixel in the strand buffer (3, or 4 with white)
+
+  /*
+   * n pixels from the start of the strand set to color
+   */
+  void (*fill)(uint8_t *buf, uint16_t n, uint32_t color);
+
+  /*
+   * pixel i set to color
+   */
+  void (*put)(uint8_t *buf, uint16_t i, uint32_t color);
+
+  /*
+   * n pixels from pixel first set from r, g, b bytes (white off)
+   */
+  void (*rgb)(uint8_t *buf, uint16_t first, uint16_t n, const uint8_t *rgb);
+
+  /*
+   * n pixels set to lut[(uint8_t)(idx[i] + add)]
+   */
+  void (*lut8)(uint8_t *buf, uint16_t n, const uint8_t *idx, uint8_t add, const uint32_t *lut);
+
+  /*
+   * n pixels set to lut[] of 4 bit indices, two to a byte, high nibble first
+   */
+  void (*lut4)(uint8_t *buf, uint16_t n, const uint8_t *idx, const uint32_t *lut);
+} neo_px_t;
+
+extern const neo_px_t *neo_px;          // gamma (if enabled) and brightness
+extern const neo_px_t *neo_px_nogamma;  // brightness only (colors already corrected, streams)
+
+bool neo_px_select(neoPixelType type, bool gamma, uint8_t brightness);
+
+/*
+ * 16 bit colors: 8.8 fixed point channels, 0xFF00 is full on.
+ * they are corrected at 16 bits and then either rounded to 8 or
+ * dithered over time (neo_px_dither()).
+ */
+typedef struct {
+  uint16_t red;
+  uint16_t green;
+  uint16_t blue;
+  uint16_t white;
+} neo_color16_t;
+
+bool neo_px_dither_begin(uint16_t n);
+uint32_t neo_px_dither_bytes(void);
+bool neo_px_fill16(uint8_t *buf, uint16_t n, const neo_color16_t *color, bool dither);
+bool neo_px_dither(uint8_t *buf, uint16_t n);
+
+#define __NEO_PIXEL_H__
+#endif
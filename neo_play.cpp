@@ -10,7 +10,12 @@
 
 #include <ArduinoJson.h>
 
+#include "bt_fsio.h"
+#include "bt_jsonpool.h"
+#include "bt_loglib.h"
 #include "neo_data.h"
+#include "neo_pixel.h"
+#include "neo_sync.h"
 #include "app_pins.h"
 
 // TRACE output simplified, can be deactivated here ... switched to arduino debug library
@@ -28,7 +33,28 @@
 //   NEO_GRB     Pixels are wired for GRB bitstream (most NeoPixel products)
 //   NEO_RGB     Pixels are wired for RGB bitstream (v1 FLORA pixels, not v2)
 //   NEO_RGBW    Pixels are wired for RGBW bitstream (NeoPixel RGBW products)
+// (the type comes from the eeprom, see neo_pixel.cpp for the ones that can be used)
 Adafruit_NeoPixel *pixels;
+static neoPixelType neo_type = NEO_TYPE;
+static bool neo_gamma = false;
+
+/*
+ * temporal dithering
+ * the single color strategies (points, single, slowp) render at 16 bits
+ * per channel (neo_write16()), which mostly matters at the dim end, where
+ * 8 bits after gamma leaves only a few levels.  if the strand is short
+ * enough to be refreshed at NEO_DITHER_MIN_HZ or more without show() taking
+ * more than 1/NEO_DITHER_DUTY of the time, the fractions are dithered: the
+ * frame is rewritten every dither_us from neo_cycle_next() for as long as
+ * the color has fractions (see neo_pixel.cpp).  otherwise it's rounded to
+ * 8 bits and written once, as everything else is.
+ *
+ * the governor works out dither_us from the strand length in neo_init()
+ * and backs it off if show() turns out to take longer, down to off.
+ */
+static uint32_t dither_us = 0;      // frame period when dithering, 0: off
+static uint32_t dither_last = 0;    // micros() at the last show()
+static bool dither_live = false;    // the strand shows a color that needs refreshing
 
 
 /*
@@ -43,42 +69,103 @@ static uint8_t neo_state = NEO_SEQ_START;  // state of the cycling state machine
 
 seq_strategy_t current_strategy = SEQ_STRAT_POINTS;
 
-uint64_t current_millis = 0; // mS of last update
+uint64_t current_millis = 0; // mS of last update (on the shared clock, see neo_sync.cpp)
 int32_t current_index = 0;   // index into the pattern array
 
 /*
- * return the index in neo_sequences[] that matches
+ * have interval mS passed since current_millis?
+ * if so, current_millis moves on by exactly interval (not to now) so that
+ * the latency of the 2 mS service tick doesn't add up over time and boards
+ * running from the same shared clock stay in step.  if it has fallen more
+ * than a whole interval behind it catches up to now rather than bursting.
+ */
+static bool neo_interval_due(int32_t interval)  {
+  uint64_t now = neo_sync_millis();
+
+  if((int64_t)(now - current_millis) < interval)
+    return(false);
+  current_millis += interval;
+  if((int64_t)(now - current_millis) >= interval)
+    current_millis = now;
+  return(true);
+}
+
+/*
+ * return the sequence index (see neo_data.h) that matches
  * the label given as an argument.  Do *not* set the global
  * index value that is used to play the sequence.
  */
 int8_t neo_find_sequence(const char *label)  {
   int8_t ret = -1;
-  for(int i = 0; i < MAX_SEQUENCES; i++)  {
-    if(strcmp(label, neo_sequences[i].label) == 0)
+  for(int i = 0; i < NEO_BUILTIN_SEQ; i++)  {
+    if(strcmp_P(label, (const char *)pgm_read_ptr(&neo_builtins[i].label)) == 0)
       ret = i;
   }
+  for(int i = 0; i < MAX_USER_SEQ; i++)  {
+    if(strcmp(label, neo_sequences[i].label) == 0)
+      ret = i + NEO_BUILTIN_SEQ;
+  }
   return(ret);
 }
 
+/*
+ * accessors for the contents of a sequence by index.
+ * built-ins are read out of flash on demand, one point at a time,
+ * so they never take up RAM; user sequences come from neo_sequences[].
+ */
+neo_seq_point_t neo_get_point(int8_t idx, int32_t pt)  {
+  neo_seq_point_t p;
+
+  if(idx < NEO_BUILTIN_SEQ)
+    memcpy_P(&p, (const neo_seq_point_t *)pgm_read_ptr(&neo_builtins[idx].point) + pt, sizeof(p));
+  else
+    p = neo_sequences[idx - NEO_BUILTIN_SEQ].point[pt];
+  return(p);
+}
+
+/*
+ * buf must hold at least MAX_NEO_STRATEGY chars
+ */
+void neo_get_strategy(int8_t idx, char *buf)  {
+  if(idx < NEO_BUILTIN_SEQ)
+    strncpy_P(buf, (const char *)pgm_read_ptr(&neo_builtins[idx].strategy), MAX_NEO_STRATEGY-1);
+  else
+    strncpy(buf, neo_sequences[idx - NEO_BUILTIN_SEQ].strategy, MAX_NEO_STRATEGY-1);
+  buf[MAX_NEO_STRATEGY-1] = '\0';
+}
+
+/*
+ * buf must hold at least MAX_NEO_BONUS chars
+ */
+void neo_get_bonus(int8_t idx, char *buf)  {
+  if(idx < NEO_BUILTIN_SEQ)
+    strncpy_P(buf, (const char *)pgm_read_ptr(&neo_builtins[idx].bonus), MAX_NEO_BONUS-1);
+  else
+    strncpy(buf, neo_sequences[idx - NEO_BUILTIN_SEQ].bonus, MAX_NEO_BONUS-1);
+  buf[MAX_NEO_BONUS-1] = '\0';
+}
+
 
 /*
  * which/set sequence are we playing out
  * returns: -1 if the label doesn't match a sequence
  * reset the playout index and state if the found index
- * is different than the currently running index.
+ * is different than the currently running index
+ * (or always with restart, e.g. when the slot has new contents).
  */
 int8_t seq_index = -1;  // global used to hold the index of the currently running sequence
-int8_t neo_set_sequence(const char *label, const char *strategy)  {
+static int8_t neo_start_sequence(const char *label, const char *strategy, bool restart)  {
   int8_t ret = NEO_SEQ_ERR;
   int8_t new_index = 0;
   seq_strategy_t new_strat;
+  char builtin_strat[MAX_NEO_STRATEGY];
 
 
   /*
    * attempt to set the sequence
    */
   new_index = neo_find_sequence(label);
-  if((new_index >= 0) && (new_index != seq_index))  {
+  if((new_index >= 0) && (restart || (new_index != seq_index)))  {
     seq_index = new_index;  // set the sequence index that is to be played
     ret = NEO_SUCCESS; // success
   }
@@ -91,9 +178,10 @@ int8_t neo_set_sequence(const char *label, const char *strategy)  {
    * the initialized value
    */
   if(strategy[0] == '\0')  {
-    DEBUG_INFO("neo_set_sequence: using built in strategy %s for seq_index %d\n", neo_sequences[seq_index].strategy,seq_index);
     if(ret == NEO_SUCCESS)  {
-      if((new_strat = neo_set_strategy(neo_sequences[seq_index].strategy)) == SEQ_STRAT_UNDEFINED)
+      neo_get_strategy(seq_index, builtin_strat);
+      DEBUG_INFO("neo_set_sequence: using built in strategy %s for seq_index %d\n", builtin_strat, seq_index);
+      if((new_strat = neo_set_strategy(builtin_strat)) == SEQ_STRAT_UNDEFINED)
         ret = NEO_STRAT_ERR;
     }
   }
@@ -111,6 +199,9 @@ int8_t neo_set_sequence(const char *label, const char *strategy)  {
   * if all above was successful, set up the globals and start the sequence
   */
   if(ret == NEO_SUCCESS)  {
+    if(current_strategy == SEQ_STRAT_STREAM)
+      neo_stream_release();  // the stream being replaced won't get to stop
+    dither_live = false;
     current_index = 0;  // reset the pixel count
     neo_state = NEO_SEQ_START;  // cause the state machine to start at the start
     current_strategy = new_strat;
@@ -120,6 +211,35 @@ int8_t neo_set_sequence(const char *label, const char *strategy)  {
   return(ret);
 }
 
+int8_t neo_set_sequence(const char *label, const char *strategy)  {
+  return(neo_start_sequence(label, strategy, false));
+}
+
+/*
+ * copy the label of the sequence being played into buf (MAX_NEO_LABEL chars)
+ * return: the sequence index, or -1 (and an empty label) if nothing is playing
+ */
+int8_t neo_get_playing(char *buf)  {
+  buf[0] = '\0';
+  if(seq_index >= NEO_BUILTIN_SEQ)
+    strncpy(buf, neo_sequences[seq_index - NEO_BUILTIN_SEQ].label, MAX_NEO_LABEL-1);
+  else if(seq_index >= 0)
+    strncpy_P(buf, (const char *)pgm_read_ptr(&neo_builtins[seq_index].label), MAX_NEO_LABEL-1);
+  buf[MAX_NEO_LABEL-1] = '\0';
+  return(seq_index);
+}
+
+/*
+ * overall brightness of the strand (255 = full), applied to everything
+ * written from now on (the neopixel library rescales what's on show)
+ */
+void neo_set_brightness(uint8_t brightness)  {
+  if(pixels != NULL)  {  // the web server may be up before neo_init()
+    pixels->setBrightness(brightness);
+    neo_px_select(neo_type, neo_gamma, brightness);
+  }
+}
+
 /*
  * check if the label matches a predefined USER button
  * NOTE: this was simplified when the filename attribute was
@@ -135,10 +255,83 @@ int8_t neo_is_user(const char *label)  {
 }
 
 /*
- * look for a label matching the argument, label,
- * and load a sequence from file of the same name.
- * NOTE: currently the requested sequence placeholder of the name
- * requested must exist in neo_sequences[] for this to succeed.
+ * copy the bonus and the points of a parsed sequence document
+ * into user slot seq_idx
+ *
+ * iterate over the points in the array
+ * this syntax was introduced in C++11 and is equivalent to:
+ * for (size_t i = 0; i < points.size(); i++) {
+ *   JsonObject obj = points[i];
+ *
+ * the points themselves are only logged at the verbose level, a full
+ * sequence would swamp the log ring (bt_loglib.cpp)
+ */
+static void neo_decode_sequence(JsonDocument &jsonDoc, int8_t seq_idx)  {
+  neo_data_t *seq = &neo_sequences[seq_idx - NEO_BUILTIN_SEQ];
+  JsonArray points = jsonDoc["points"].as<JsonArray>();
+
+  /*
+   * reserialize the bonus object for later deserialization
+   * (may be interpretted differently buy eash strategy)
+   */
+  serializeJson(jsonDoc["bonus"], seq->bonus);
+
+  uint16_t i = 0;
+  for(JsonObject obj : points)  {
+    if(i >= MAX_NUM_SEQ_POINTS)  {
+      DEBUG_ERROR("ERROR: neo_decode_sequence: %s has more than %d points ... truncated\n", seq->label, MAX_NUM_SEQ_POINTS);
+      break;
+    }
+    uint8_t r, g, b, w;
+    int32_t t;
+    r = obj["r"];
+    g = obj["g"];
+    b = obj["b"];
+    w = obj["w"];
+    t = obj["t"];
+    DEBUG_VERBOSE("colors = %d %d %d %d  interval = %d\n", r, g, b, w, t);
+    seq->point[i].red = r;
+    seq->point[i].green = g;
+    seq->point[i].blue = b;
+    seq->point[i].white = w;
+    seq->point[i].ms_after_last = t;
+    i++;
+  }
+
+  /*
+   * always end the list, so a document without a terminator (or shorter
+   * than what was in the slot before) doesn't play on into stale points
+   */
+  i = min(i, (uint16_t)(MAX_NUM_SEQ_POINTS - 1));
+  seq->point[i] = {0, 0, 0, 0, -1};
+  DEBUG_INFO("neo_decode_sequence: %u points into %s\n", i, seq->label);
+}
+
+/*
+ * find a RAM slot for a file's sequence that isn't loaded yet:
+ * the slots (other than the scratch slot) are reused in turn,
+ * skipping the one that is playing, and take the new label.
+ * return: the sequence index, or -1 if there's no slot
+ */
+static int8_t neo_claim_slot(const char *label)  {
+  static uint8_t next_slot = 0;
+  int8_t slot;
+
+  for(uint8_t n = 0; n < (MAX_USER_SEQ - 1); n++)  {
+    slot = next_slot;
+    next_slot = (next_slot + 1) % (MAX_USER_SEQ - 1);  // the last one is the scratch slot
+    if((slot + NEO_BUILTIN_SEQ) == seq_index)
+      continue;
+    strncpy(neo_sequences[slot].label, label, MAX_NEO_LABEL - 1);
+    neo_sequences[slot].label[MAX_NEO_LABEL - 1] = '\0';
+    return(slot + NEO_BUILTIN_SEQ);
+  }
+  return(-1);
+}
+
+/*
+ * load the sequence from file into the RAM slot with the same label,
+ * or into the next free slot (see neo_claim_slot()) if it isn't loaded.
  *
  * return:   0: successfully loaded
  *          -1: file not found or error opening
@@ -147,17 +340,15 @@ int8_t neo_is_user(const char *label)  {
 int8_t neo_load_sequence(const char *file)  {
 
   FSInfo fs_info;
-  LittleFS.info(fs_info);
+  fsio_info(FSIO_SEQ_LOAD, fs_info);
 
-  JsonDocument jsonDoc;
+  JsonDocument jsonDoc(json_pool());
   DeserializationError err;
 
   int8_t ret = 0;
   File fd;  // file pointer to read from
-  char buf[1024];  // buffer in which to read the file contents  TODO: paramaterize
-  char *pbuf;  // helper
- 
-  pbuf = buf;
+  char buf[MAX_NEO_FILE];  // buffer in which to read the file contents
+  size_t n;
 
   /*
    * can I see the FS from here ? ... yep.
@@ -176,15 +367,13 @@ int8_t neo_load_sequence(const char *file)  {
   else  {
 
     DEBUG_INFO("Loading filename %s ...\n", file);
-    if((fd = LittleFS.open(file, "r")) == false)  
+    if((fd = fsio_open(FSIO_SEQ_LOAD, file, "r")) == false)
       ret = NEO_FILE_LOAD_NOFILE;
 
     else  {
-      while(fd.available())  {
-        *pbuf++ = fd.read();
-      }
-      *pbuf = '\0';  // terminate the char string
-      fd.close();
+      n = fsio_read(FSIO_SEQ_LOAD, fd, (uint8_t *)buf, MAX_NEO_FILE - 1);
+      buf[n] = '\0';  // terminate the char string
+      fsio_close(FSIO_SEQ_LOAD, fd);
       DEBUG_VERBOSE("Raw file contents:\n%s\n", buf);
 
       /*
@@ -197,13 +386,8 @@ int8_t neo_load_sequence(const char *file)  {
         ret = NEO_FILE_LOAD_DESERR;
       }
 
-      /*
-      * jsonDoc contains an array of points as JsonObjects
-      * convert to a JsonArray points[]
-      */
       else  {
-        JsonArray points = jsonDoc["points"].as<JsonArray>();
-        const char *label, *bonus;
+        const char *label;
         label = jsonDoc["label"];
 
         DEBUG_INFO("For sequence \"%s\" : \n", label);
@@ -211,15 +395,11 @@ int8_t neo_load_sequence(const char *file)  {
         /*
          * find the place in neo_sequences[] where the file contents should be copied/stored
          */
-        int8_t seq_idx = neo_find_sequence(label);
+        int8_t seq_idx = (label != NULL) ? neo_find_sequence(label) : -1;
+        if((label != NULL) && (seq_idx < 0))
+          seq_idx = neo_claim_slot(label);
 
-        /*
-        * iterate over the points in the array
-        * this syntax was introduced in C++11 and is equivalent to:
-        * for (size_t i = 0; i < points.size(); i++) {
-        *   JsonObject obj = points[i];
-        */
-        if(seq_idx < 0)  {
+        if(seq_idx < NEO_BUILTIN_SEQ)  {  // also catches built-ins, which are read-only
           ret = NEO_FILE_LOAD_NOPLACE;
           DEBUG_ERROR("ERROR: neo_load_sequence: no placeholder for %s in sequence array\n", label);
         }
@@ -227,34 +407,10 @@ int8_t neo_load_sequence(const char *file)  {
         /*
         * if the label was found, load the points from the json file
         * into the neo_sequences[] array to be played out
-        *
-        * TODO: super-verbose for now for debugging
         */
         else  {
-          /*
-           * reserialize the bonus object for later deserialization
-           * (may be interpretted differently buy eash strategy)
-           */
-          serializeJson(jsonDoc["bonus"], neo_sequences[seq_idx].bonus);
-
-          uint16_t i = 0;
-          for(JsonObject obj : points)  {
-            uint8_t r, g, b, w;
-            int32_t t;
-            r = obj["r"];
-            g = obj["g"];
-            b = obj["b"];
-            w = obj["w"];
-            t = obj["t"];
-            DEBUG_INFO("colors = %d %d %d %d  interval = %d\n", r, g, b, w, t);
-            neo_sequences[seq_idx].point[i].red = r;
-            neo_sequences[seq_idx].point[i].green = g;
-            neo_sequences[seq_idx].point[i].blue = b;
-            neo_sequences[seq_idx].point[i].white = w;
-            neo_sequences[seq_idx].point[i].ms_after_last = t;
-            i++;
-          }
-          ret = neo_set_sequence(label, jsonDoc["strategy"]);
+          neo_decode_sequence(jsonDoc, seq_idx);
+          ret = neo_set_sequence(label, jsonDoc["strategy"] | "points");
         }
       }
     }
@@ -263,44 +419,94 @@ int8_t neo_load_sequence(const char *file)  {
 }
 
 /*
- * convert r, g, b to Adafruit color with/without gamma32()
- * based on eeprom configuration parameter.
- * this is called once in setup() to set a function pointer
- * for efficient operation
+ * play a complete sequence document (same format as a sequence file)
+ * straight from RAM: it's decoded into the scratch slot and started
+ * without anything being read from or written to the file system.
+ * the label in the document is only informational.
+ * playing the scratch slot again restarts it with the new contents.
+ *
+ * return: NEO_SUCCESS or the error from decoding/setting the sequence
  */
-uint32_t (*neo_convert_color)(uint8_t r, uint8_t g, uint8_t b);
+int8_t neo_play_json(const char *json, size_t len)  {
+  JsonDocument jsonDoc(json_pool());
+  DeserializationError err;
+  int8_t seq_idx = neo_find_sequence(NEO_SCRATCH_LABEL);
 
-uint32_t neo_color_gamma(uint8_t r, uint8_t g, uint8_t b)  {
-  return pixels->gamma32(pixels->Color(r, g, b));
-}
-uint32_t neo_color_nogamma(uint8_t r, uint8_t g, uint8_t b)  {
-    return (pixels->Color(r, g, b));
+  err = deserializeJson(jsonDoc, json, len);
+  if(err)  {
+    DEBUG_ERROR("ERROR: neo_play_json: deserialization failed: %s\n", err.c_str());
+    return(NEO_DESERR);
+  }
+  if(!jsonDoc["points"].is<JsonArray>() || (jsonDoc["points"].size() == 0))  {
+    DEBUG_ERROR("ERROR: neo_play_json: no points in sequence\n");
+    return(NEO_DESERR);
+  }
+
+  DEBUG_INFO("neo_play_json: playing \"%s\" from RAM\n", (const char *)(jsonDoc["label"] | ""));
+  neo_decode_sequence(jsonDoc, seq_idx);
+  return(neo_start_sequence(NEO_SCRATCH_LABEL, jsonDoc["strategy"] | "points", true));  // restarted even if it's playing
 }
 
+/*
+ * gamma correction or not, based on eeprom configuration parameter.
+ * this is called once in setup() to pick the pixel writers (neo_px)
+ * for efficient operation
+ */
 void neo_set_gamma_color(bool gamma_enable)  {
-  if(gamma_enable)
-    neo_convert_color = neo_color_gamma;
-  else
-    neo_convert_color = neo_color_nogamma;
+  neo_gamma = gamma_enable;
+  neo_px_select(neo_type, neo_gamma, (pixels != NULL) ? pixels->getBrightness() : 255);
 }
 
+static void neo_dither_show(void)  {
+  uint32_t start = micros(), took;
 
+  pixels->show();
+  dither_last = start;
+  if(!dither_live)
+    return;
+
+  took = micros() - start;
+  if((took * NEO_DITHER_DUTY) > dither_us)  {
+    dither_us = took * NEO_DITHER_DUTY;
+    if(dither_us > (1000000 / NEO_DITHER_MIN_HZ))  {
+      DEBUG_INFO("neo_dither: show() takes %u uS ... dithering off\n", (unsigned)took);
+      dither_us = 0;
+      dither_live = false;
+    }
+  }
+}
+
+/*
+ * the whole strand set to a 16 bit color (with gamma if enabled) and shown
+ */
+static void neo_write16(uint16_t r, uint16_t g, uint16_t b, uint16_t w)  {
+  neo_color16_t c = { r, g, b, w };
+
+  dither_live = neo_px_fill16(pixels->getPixels(), pixels->numPixels(), &c, (dither_us > 0));
+  neo_dither_show();
+}
+
+/*
+ * called every time through neo_cycle_next(): the next dithered frame, if it's time
+ */
+static void neo_dither_service(void)  {
+  if(!dither_live || ((micros() - dither_last + (NEO_UPDATE_INTERVAL / 2)) < dither_us))
+    return;  // (half a tick early is on time, or it would slip to every other tick)
+  dither_live = neo_px_dither(pixels->getPixels(), pixels->numPixels());
+  neo_dither_show();
+}
 
 /*
  * helper for writing a single color to all pixels
  */
 void neo_write_pixel(bool clear)  {
-  if(clear != 0)  pixels->clear(); // Set all pixel colors to 'off'
+  neo_seq_point_t p = neo_get_point(seq_index, current_index);
 
   /*
     * send the next point in the sequence to the strand
+    * (every pixel is written, so there's nothing to clear first)
     */
-  for(int i=0; i < pixels->numPixels(); i++) { // For each pixel...
-    pixels->setPixelColor(i, neo_convert_color( neo_sequences[seq_index].point[current_index].red, 
-                                                neo_sequences[seq_index].point[current_index].green,
-                                                neo_sequences[seq_index].point[current_index].blue));
-  }
-  pixels->show();   // Send the updated pixel colors to the hardware.
+  neo_write16(p.red << 8, p.green << 8, p.blue << 8, p.white << 8);
 }
 
 /*
@@ -319,8 +525,8 @@ void neo_n_blinks(uint8_t r, uint8_t g, uint8_t b, int8_t reps, int32_t t)  {
     /*
     * send the next point in the sequence to the strand
     */
-    for(int i=0; i < pixels->numPixels(); i++) // For each pixel...
-      pixels->setPixelColor(i, color);
+    dither_live = false;
+    neo_px_nogamma->fill(pixels->getPixels(), pixels->numPixels(), color);
     pixels->show();   // Send the updated pixel colors to the hardware.
 
     delay(t);
@@ -332,16 +538,52 @@ void neo_n_blinks(uint8_t r, uint8_t g, uint8_t b, int8_t reps, int32_t t)  {
   }
 }
 
+/*
+ * set the whole strand to one color right away (0, 0, 0 is off)
+ * for status indications that can't block like neo_n_blinks()
+ */
+void neo_fill(uint8_t r, uint8_t g, uint8_t b)  {
+  if(pixels == NULL)
+    return;
+  dither_live = false;
+  neo_px_nogamma->fill(pixels->getPixels(), pixels->numPixels(), pixels->Color(r, g, b));
+  pixels->show();
+}
+
 /*
  * initialize the neopixel strand and set it to off/idle
  */
 void neo_init(uint16_t numPixels, int16_t pin, neoPixelType pixelFormat)  {
+  if(neo_px_select(pixelFormat, neo_gamma, 255) == false)  {
+    DEBUG_ERROR("ERROR: neo_init: no pixel writers for type 0x%x ... using NEO_TYPE\n", pixelFormat);
+    pixelFormat = NEO_TYPE;
+  }
+  neo_type = pixelFormat;
   pixels = new Adafruit_NeoPixel(numPixels, pin, pixelFormat);
 
   pixels->begin(); // INITIALIZE NeoPixel strip object (REQUIRED)
   pixels->clear(); // Set all pixel colors to 'off'
   pixels->show();   // Send the updated pixel colors to the hardware.
   neo_state = NEO_SEQ_STOPPED;
+
+  /*
+   * frame-rate governor: show() sends 24 (32 with white) bits a pixel at
+   * 1.25 uS each and then waits out the 300 uS latch.  dithering can't go
+   * faster than the update tick.  (a 400 kHz strand is caught when the
+   * first dithered frames are timed in neo_dither_show())
+   */
+  uint32_t show_us = (((uint32_t)numPixels * neo_px->bpp * 8 * 5) / 4) + 300;
+  dither_us = max(show_us * NEO_DITHER_DUTY, (uint32_t)NEO_UPDATE_INTERVAL);
+  if(dither_us > (1000000 / NEO_DITHER_MIN_HZ))
+    dither_us = 0;
+  else if(neo_px_dither_begin(numPixels) == false)  {
+    DEBUG_ERROR("ERROR: neo_init: no memory for dithering\n");
+    dither_us = 0;
+  }
+  if(dither_us > 0)
+    DEBUG_INFO("neo_init: dithering 16 bit colors at %u Hz\n", (unsigned)(1000000 / dither_us));
+  else
+    DEBUG_INFO("neo_init: %u uS per frame is too slow for dithering, 16 bit colors are rounded\n", (unsigned)show_us);
 }
 
 /*
@@ -364,26 +606,23 @@ void start_noop(bool clear) {}
  */
 void neo_points_start(bool clear) {
   neo_write_pixel(true);  // clear the strand and write the first value
-  current_millis = millis();
+  current_millis = neo_sync_millis();
   neo_state = NEO_SEQ_WAIT;
 }
 
 void neo_points_write(void) {
-  if(neo_sequences[seq_index].point[current_index].ms_after_last < 0)  // list terminator: nothing to write
+  if(neo_get_point(seq_index, current_index).ms_after_last < 0)  // list terminator: nothing to write
     current_index = 0;
   neo_write_pixel(false);
   neo_state = NEO_SEQ_WAIT;
 }
 
 void neo_points_wait(void)  {
-  uint64_t new_millis = 0;
-
   /*
     * if the timer has expired (or assumed that if current_millis == 0, then it will be)
     * i.e. done waiting move to the next state
     */
-  if(((new_millis = millis()) - current_millis) >= neo_sequences[seq_index].point[current_index].ms_after_last)  {
-    current_millis = new_millis;
+  if(neo_interval_due(neo_get_point(seq_index, current_index).ms_after_last))  {
     current_index++;
     neo_state = NEO_SEQ_WRITE;
   }
@@ -391,6 +630,7 @@ void neo_points_wait(void)  {
 }
 
 void neo_points_stopping(void)  {
+  dither_live = false;
   pixels->clear(); // Set all pixel colors to 'off'
   pixels->show();   // Send the updated pixel colors to the hardware.
   current_index = 0;
@@ -414,9 +654,10 @@ void neo_points_stopping(void)  {
 static int8_t single_repeats = 1;
 
 void neo_single_start(bool clear) {
-  JsonDocument jsonDoc;
+  JsonDocument jsonDoc(json_pool());
   DeserializationError err;
   const char *jbuf;  // jsonDoc[] requires this type
+  char bonus[MAX_NEO_BONUS];  // copy of the bonus (may come from flash)
 
   neo_write_pixel(true);  // clear the strand and write the first value
 
@@ -431,10 +672,11 @@ void neo_single_start(bool clear) {
    * obtain the number of times the "single" sequence will be run
    * based on the "bonus" parameter from the json sequence file
    */
-  if(strlen(neo_sequences[seq_index].bonus) > 0)  {
-    DEBUG_DEBUG("neo_single_start: bonus = %s\n", neo_sequences[seq_index].bonus);
+  neo_get_bonus(seq_index, bonus);
+  if(strlen(bonus) > 0)  {
+    DEBUG_DEBUG("neo_single_start: bonus = %s\n", bonus);
 
-    err = deserializeJson(jsonDoc, neo_sequences[seq_index].bonus);
+    err = deserializeJson(jsonDoc, bonus);
 
     if(err)  {
       DEBUG_ERROR("ERROR: Deserialization of bonus failed ... using zero\n");
@@ -458,12 +700,12 @@ void neo_single_start(bool clear) {
   /*
    * get the timing started
    */
-  current_millis = millis();
+  current_millis = neo_sync_millis();
   neo_state = NEO_SEQ_WAIT;
 }
 
 void neo_single_write(void) {
-  if(neo_sequences[seq_index].point[current_index].ms_after_last < 0)  {  // list terminator
+  if(neo_get_point(seq_index, current_index).ms_after_last < 0)  {  // list terminator
     current_index = 0;  // rewind in case we're going to play it again
     if(--single_repeats > 0)  {  // are we going to play it again?
       neo_state = NEO_SEQ_WAIT;  // yep
@@ -501,8 +743,9 @@ void neo_single_write(void) {
 static int32_t slowp_idx = 0;  // counting through the NEO_SLOWP_POINTS
 static int8_t slowp_dir = 1;  // +1 -1 to indicate the direction we're traveling
 static uint32_t delta_time;  // calculated time between changes
-static float delta_r, delta_g, delta_b;  // calculated increment for each color ... must be floats or gets rounded to 0 between calls
-static float slowp_r, slowp_g, slowp_b;  // remember where we are in the sequence
+static float delta_r, delta_g, delta_b, delta_w;  // calculated increment for each color ... must be floats or gets rounded to 0 between calls
+static float slowp_r, slowp_g, slowp_b, slowp_w;  // remember where we are in the sequence
+static neo_seq_point_t slowp_pt0, slowp_pt1;  // starting and ending points, fetched once at start
 static int16_t slowp_flickers[NEO_SLOWP_FLICKERS];  // random points to flicker
 static int16_t slowp_flicker_idx = 0;
 static int8_t flicker_count = 0;  // how many flickers
@@ -527,6 +770,13 @@ static uint8_t neo_check_range(int32_t testval)  {
   return(retval);
 }
 
+/*
+ * same for the 16 bit colors: 0.0 - 255.0 to 8.8 fixed point
+ */
+static uint16_t neo_check_range16(float testval)  {
+  return((uint16_t)(constrain(testval, 0.0f, 255.0f) * 256.0f));
+}
+
 void neo_slowp_start(bool clear)  {
 
   slowp_idx = 0;
@@ -534,15 +784,19 @@ void neo_slowp_start(bool clear)  {
   slowp_flicker_idx = 0;  // start at the start
   flicker_count = 0;  // assume none to Start
 
-  JsonDocument jsonDoc;
+  JsonDocument jsonDoc(json_pool());
   DeserializationError err;
   const char *jbuf;  // jsonDoc[] requires this type
+  char bonus[MAX_NEO_BONUS];  // copy of the bonus (may come from flash)
+
+  slowp_pt0 = neo_get_point(seq_index, 0);
+  slowp_pt1 = neo_get_point(seq_index, 1);
 
   /*
    * calculate delta time in mS based on the first (and only)
    * line in the json sequence file
    */
-  delta_time = (neo_sequences[seq_index].point[0].ms_after_last * 1000) / NEO_SLOWP_POINTS;
+  delta_time = (slowp_pt0.ms_after_last * 1000) / NEO_SLOWP_POINTS;
 
   /*
    * calculate the delta chance for each color
@@ -550,25 +804,28 @@ void neo_slowp_start(bool clear)  {
    * of the sequence
    *
    */
-  delta_r = (neo_sequences[seq_index].point[1].red - neo_sequences[seq_index].point[0].red) / (float)NEO_SLOWP_POINTS;  // cast needed to force floating point math
-  delta_g = (neo_sequences[seq_index].point[1].green - neo_sequences[seq_index].point[0].green) / (float)NEO_SLOWP_POINTS;
-  delta_b = (neo_sequences[seq_index].point[1].blue - neo_sequences[seq_index].point[0].blue) / (float)NEO_SLOWP_POINTS;
+  delta_r = (slowp_pt1.red - slowp_pt0.red) / (float)NEO_SLOWP_POINTS;  // cast needed to force floating point math
+  delta_g = (slowp_pt1.green - slowp_pt0.green) / (float)NEO_SLOWP_POINTS;
+  delta_b = (slowp_pt1.blue - slowp_pt0.blue) / (float)NEO_SLOWP_POINTS;
+  delta_w = (slowp_pt1.white - slowp_pt0.white) / (float)NEO_SLOWP_POINTS;
 
   /*
    * start from the json specified starting point
    */
-  slowp_r = neo_sequences[seq_index].point[0].red;
-  slowp_g = neo_sequences[seq_index].point[0].green;
-  slowp_b = neo_sequences[seq_index].point[0].blue;
+  slowp_r = slowp_pt0.red;
+  slowp_g = slowp_pt0.green;
+  slowp_b = slowp_pt0.blue;
+  slowp_w = slowp_pt0.white;
 
   /*
    * obtain the random places where the lights will flicker
    * based on the "bonus" parameter from the json sequence file
    */
-  if(strlen(neo_sequences[seq_index].bonus) > 0)  {
-    DEBUG_DEBUG("neo_slowp_start: bonus = %s\n", neo_sequences[seq_index].bonus);
+  neo_get_bonus(seq_index, bonus);
+  if(strlen(bonus) > 0)  {
+    DEBUG_DEBUG("neo_slowp_start: bonus = %s\n", bonus);
 
-    err = deserializeJson(jsonDoc, neo_sequences[seq_index].bonus);
+    err = deserializeJson(jsonDoc, bonus);
 
     if(err)  {
       DEBUG_ERROR("ERROR: Deserialization of bonus failed ... using zero\n");
@@ -630,19 +887,13 @@ void neo_slowp_start(bool clear)  {
     DEBUG_INFO("%d  ", slowp_flickers[j]);
   DEBUG_INFO("\n");
 
-  uint8_t r = neo_check_range(slowp_r);
-  uint8_t g = neo_check_range(slowp_g);
-  uint8_t b = neo_check_range(slowp_b);
-
   /*
-   * clear and write the starting value
+   * write the starting value
    */
-  pixels->clear();
-  for(int i=0; i < pixels->numPixels(); i++)  // For each pixel...
-      pixels->setPixelColor(i, neo_convert_color(r, g, b));
-  pixels->show();   // Send the updated pixel colors to the hardware.
+  neo_write16(neo_check_range16(slowp_r), neo_check_range16(slowp_g),
+              neo_check_range16(slowp_b), neo_check_range16(slowp_w));
 
-  current_millis = millis();
+  current_millis = neo_sync_millis();
 
   neo_state = NEO_SEQ_WAIT;
 
@@ -650,7 +901,7 @@ void neo_slowp_start(bool clear)  {
 
 
 void neo_slowp_write(void) {
-  uint8_t r, g, b;
+  uint16_t r, g, b, w;
 
   //DEBUG_DEBUG("slowp_idx = %d\n", slowp_idx); // warning: burps out a lot of stuff
 
@@ -662,6 +913,7 @@ void neo_slowp_write(void) {
       slowp_r += delta_r;  // increment by the delta per point change
       slowp_g += delta_g;
       slowp_b += delta_b;
+      slowp_w += delta_w;
     }
     else  {
       slowp_dir = -1;  // change to going down
@@ -670,9 +922,10 @@ void neo_slowp_write(void) {
       /*
        * reset to the ending point in case of rounding error
        */
-      slowp_r = neo_sequences[seq_index].point[1].red;
-      slowp_g = neo_sequences[seq_index].point[1].green;
-      slowp_b = neo_sequences[seq_index].point[1].blue;
+      slowp_r = slowp_pt1.red;
+      slowp_g = slowp_pt1.green;
+      slowp_b = slowp_pt1.blue;
+      slowp_w = slowp_pt1.white;
     }
   }
 
@@ -684,6 +937,7 @@ void neo_slowp_write(void) {
       slowp_r -= delta_r;
       slowp_g -= delta_g;
       slowp_b -= delta_b;
+      slowp_w -= delta_w;
     }
     else  {
       slowp_dir = 1;  // change to going down
@@ -692,9 +946,10 @@ void neo_slowp_write(void) {
       /*
        * reset to the starting point  in case of rounding error
        */
-      slowp_r = neo_sequences[seq_index].point[0].red;
-      slowp_g = neo_sequences[seq_index].point[0].green;
-      slowp_b = neo_sequences[seq_index].point[0].blue;
+      slowp_r = slowp_pt0.red;
+      slowp_g = slowp_pt0.green;
+      slowp_b = slowp_pt0.blue;
+      slowp_w = slowp_pt0.white;
     }
   }
 
@@ -702,15 +957,15 @@ void neo_slowp_write(void) {
    * send the next point in the sequence to the strand
    */
   if(flicker_count == 0)  {  // no flickers
-          r = neo_check_range(slowp_r);
-          g = neo_check_range(slowp_g);
-          b = neo_check_range(slowp_b);
+          r = neo_check_range16(slowp_r);
+          g = neo_check_range16(slowp_g);
+          b = neo_check_range16(slowp_b);
   }
   else  {
     if(slowp_idx == slowp_flickers[slowp_flicker_idx])  {
-        r = flicker_r;
-        g = flicker_g;
-        b = flicker_b;
+        r = flicker_r << 8;
+        g = flicker_g << 8;
+        b = flicker_b << 8;
 
       if(slowp_dir > 0)  {
         if(++slowp_flicker_idx >= flicker_count)
@@ -723,16 +978,14 @@ void neo_slowp_write(void) {
 //      DEBUG_DEBUG("slowp_flicker_idx = %d\n", slowp_flicker_idx);
     }
     else  {
-      r = neo_check_range(slowp_r);
-      g = neo_check_range(slowp_g);
-      b = neo_check_range(slowp_b);
+      r = neo_check_range16(slowp_r);
+      g = neo_check_range16(slowp_g);
+      b = neo_check_range16(slowp_b);
 
     }
   }
-  for(int i=0; i < pixels->numPixels(); i++)  // For each pixel...
-      pixels->setPixelColor(i, neo_convert_color(r, g, b));
-
-  pixels->show();   // Send the updated pixel colors to the hardware.
+  w = neo_check_range16(slowp_w);  // flickers are r, g, b only
+  neo_write16(r, g, b, w);  // Send the updated pixel colors to the hardware.
 
 #ifdef DEBUG_HACK
   DEBUG_VERBOSE("neo_slowp_write: Showed %d  %d  %d\n", slowp_r, slowp_g, slowp_b);
@@ -745,14 +998,11 @@ void neo_slowp_write(void) {
 
 
 void neo_slowp_wait(void)  {
-  uint64_t new_millis = 0;
-
   /*
     * if the timer has expired (or assumed that if current_millis == 0, then it will be)
     * i.e. done waiting move to the next state
     */
-  if(((new_millis = millis()) - current_millis) >= delta_time)  {
-    current_millis = new_millis;
+  if(neo_interval_due(delta_time))  {
     neo_state = NEO_SEQ_WRITE;
   }
 
@@ -780,9 +1030,10 @@ void neo_pong_start(bool clear)  {
   slowp_idx = 0;
   slowp_dir = 1;  // start by going up
 
-  JsonDocument jsonDoc;
+  JsonDocument jsonDoc(json_pool());
   DeserializationError err;
   const char *jbuf;  // jsonDoc[] requires this type
+  char bonus[MAX_NEO_BONUS];  // copy of the bonus (may come from flash)
 
   pong_repeats = -1; // start with continuous
 
@@ -790,10 +1041,11 @@ void neo_pong_start(bool clear)  {
    * obtain the number of times the sequence will be run
    * based on the "bonus" parameter from the json sequence file
    */
-  if(strlen(neo_sequences[seq_index].bonus) > 0)  {
-    DEBUG_DEBUG("neo_pong_start: bonus = %s\n", neo_sequences[seq_index].bonus);
+  neo_get_bonus(seq_index, bonus);
+  if(strlen(bonus) > 0)  {
+    DEBUG_DEBUG("neo_pong_start: bonus = %s\n", bonus);
 
-    err = deserializeJson(jsonDoc, neo_sequences[seq_index].bonus);
+    err = deserializeJson(jsonDoc, bonus);
 
     if(err)  {
       DEBUG_ERROR("ERROR: Deserialization of bonus failed ... using zero\n");
@@ -812,11 +1064,14 @@ void neo_pong_start(bool clear)  {
 
   p_num_pixels = pixels->numPixels();
 
+  slowp_pt0 = neo_get_point(seq_index, 0);
+  slowp_pt1 = neo_get_point(seq_index, 1);
+
   /*
    * calculate delta time in mS based on the first
    * line in the json sequence file
    */
-  delta_time = (neo_sequences[seq_index].point[0].ms_after_last) / p_num_pixels;
+  delta_time = (slowp_pt0.ms_after_last) / p_num_pixels;
 
   /*
    * calculate the delta chance for each color
@@ -824,27 +1079,30 @@ void neo_pong_start(bool clear)  {
    * of the sequence
    *
    */
-  delta_r = (neo_sequences[seq_index].point[1].red - neo_sequences[seq_index].point[0].red) / (float)(p_num_pixels-1);  // cast needed to force floating point math
-  delta_g = (neo_sequences[seq_index].point[1].green - neo_sequences[seq_index].point[0].green) / (float)(p_num_pixels-1);
-  delta_b = (neo_sequences[seq_index].point[1].blue - neo_sequences[seq_index].point[0].blue) / (float)(p_num_pixels-1);
+  delta_r = (slowp_pt1.red - slowp_pt0.red) / (float)(p_num_pixels-1);  // cast needed to force floating point math
+  delta_g = (slowp_pt1.green - slowp_pt0.green) / (float)(p_num_pixels-1);
+  delta_b = (slowp_pt1.blue - slowp_pt0.blue) / (float)(p_num_pixels-1);
+  delta_w = (slowp_pt1.white - slowp_pt0.white) / (float)(p_num_pixels-1);
 
   /*
    * start from the json specified starting point
    */
-  slowp_r = neo_sequences[seq_index].point[0].red;
-  slowp_g = neo_sequences[seq_index].point[0].green;
-  slowp_b = neo_sequences[seq_index].point[0].blue;
+  slowp_r = slowp_pt0.red;
+  slowp_g = slowp_pt0.green;
+  slowp_b = slowp_pt0.blue;
+  slowp_w = slowp_pt0.white;
 
   /*
    * clear and set the first point here
    */
   pixels->clear();
-  pixels->setPixelColor(slowp_idx, neo_convert_color( neo_check_range(slowp_r),
-                                                      neo_check_range(slowp_g),
-                                                      neo_check_range(slowp_b)));  // turn on the next one
+  neo_px->put(pixels->getPixels(), slowp_idx, Adafruit_NeoPixel::Color( neo_check_range(slowp_r),
+                                                                        neo_check_range(slowp_g),
+                                                                        neo_check_range(slowp_b),
+                                                                        neo_check_range(slowp_w)));  // turn on the next one
   pixels->show();
 
-  current_millis = millis();
+  current_millis = neo_sync_millis();
 
   DEBUG_INFO("Starting pong: dr = %f, dg = %f, db = %f dt = %d\n", delta_r, delta_g, delta_b, delta_time);
 
@@ -863,6 +1121,7 @@ void neo_pong_write(void) {
       slowp_r += delta_r;
       slowp_g += delta_g;
       slowp_b += delta_b;
+      slowp_w += delta_w;
     }
     else  {
       slowp_dir = -1;  // change to going down
@@ -871,9 +1130,10 @@ void neo_pong_write(void) {
       /*
        * reset to the ending point in case of rounding error
        */
-      slowp_r = neo_sequences[seq_index].point[1].red;
-      slowp_g = neo_sequences[seq_index].point[1].green;
-      slowp_b = neo_sequences[seq_index].point[1].blue;
+      slowp_r = slowp_pt1.red;
+      slowp_g = slowp_pt1.green;
+      slowp_b = slowp_pt1.blue;
+      slowp_w = slowp_pt1.white;
     }
   }
 
@@ -886,6 +1146,7 @@ void neo_pong_write(void) {
       slowp_r -= delta_r;
       slowp_g -= delta_g;
       slowp_b -= delta_b;
+      slowp_w -= delta_w;
     }
     else  {
       slowp_dir = 1;  // change to going down
@@ -894,9 +1155,10 @@ void neo_pong_write(void) {
       /*
        * reset to the starting point  in case of rounding error
        */
-      slowp_r = neo_sequences[seq_index].point[0].red;
-      slowp_g = neo_sequences[seq_index].point[0].green;
-      slowp_b = neo_sequences[seq_index].point[0].blue;
+      slowp_r = slowp_pt0.red;
+      slowp_g = slowp_pt0.green;
+      slowp_b = slowp_pt0.blue;
+      slowp_w = slowp_pt0.white;
 
       if(pong_repeats > (int16_t)0)
         pong_repeats--;
@@ -907,9 +1169,10 @@ void neo_pong_write(void) {
    * send the next point in the sequence to the strand
    */
   pixels->clear();  // first turn them all off
-  pixels->setPixelColor(slowp_idx, neo_convert_color( neo_check_range(slowp_r),
-                                                      neo_check_range(slowp_g),
-                                                      neo_check_range(slowp_b)));  // turn on the next one
+  neo_px->put(pixels->getPixels(), slowp_idx, Adafruit_NeoPixel::Color( neo_check_range(slowp_r),
+                                                                        neo_check_range(slowp_g),
+                                                                        neo_check_range(slowp_b),
+                                                                        neo_check_range(slowp_w)));  // turn on the next one
   pixels->show();   // Send the updated pixel colors to the hardware.
 
   if(pong_repeats == (int16_t)(-1))  // not counting keep going
@@ -926,47 +1189,110 @@ void neo_pong_write(void) {
  * SEQ_STRAT_RAINBOW
  * cycle a rainbow color pallette along the whole strip
  * (adapted from the Adafruit strandtest example)
+ *
+ * rather than running ColorHSV() and gamma32() for every pixel on every
+ * frame (as pixels->rainbow() does), the 256 hues are calculated once
+ * at start into rainbow_lut[] and the hue offset of each pixel along the
+ * strand is cached in the base frame rainbow_base[].
+ * a frame is then one add and one table load per pixel (neo_px->lut8(),
+ * which does the gamma correction, if it's enabled, and the brightness).
+ *
+ * "bonus" from the json sequence file is optional, defaults in ():
+ *   "speed"  : hue steps (of 256) to advance per frame, negative reverses (1)
+ *   "spread" : number of complete rainbows along the strand (1)
+ *   "sat"    : saturation, 0 - 255 (255)
+ *   "val"    : brightness, 0 - 255 (255)
+ *   "t"      : mS between frames (10)
  */
-long firstPixelHue = 0;
+#define NEO_RAINBOW_HUES 256
+static uint32_t rainbow_lut[NEO_RAINBOW_HUES];  // uncorrected color for each hue
+static uint8_t *rainbow_base = NULL;  // hue offset of each pixel ... malloc'ed on first use
+static uint8_t rainbow_phase = 0;  // hue of the first pixel (wraps on purpose)
+static int8_t rainbow_speed = 1;
+static uint32_t rainbow_interval = 10;
+
 void neo_rainbow_start(bool clear)  {
+  JsonDocument jsonDoc(json_pool());
+  DeserializationError err;
+  char bonus[MAX_NEO_BONUS];  // copy of the bonus (may come from flash)
+  uint8_t sat = 255, val = 255;
+  uint16_t spread = 1;
+  uint16_t n = pixels->numPixels();
+
   pixels->clear();
   pixels->show();
 
-  firstPixelHue = 0;
+  rainbow_speed = 1;
+  rainbow_interval = 10;
+
+  neo_get_bonus(seq_index, bonus);
+  if(strlen(bonus) > 0)  {
+    DEBUG_DEBUG("neo_rainbow_start: bonus = %s\n", bonus);
+
+    err = deserializeJson(jsonDoc, bonus);
+    if(err)
+      DEBUG_ERROR("ERROR: Deserialization of bonus failed ... using defaults\n");
+    else  {
+      rainbow_speed = jsonDoc["speed"] | 1;
+      spread = jsonDoc["spread"] | 1;
+      sat = neo_check_range(jsonDoc["sat"] | 255);
+      val = neo_check_range(jsonDoc["val"] | 255);
+      rainbow_interval = jsonDoc["t"] | 10;
+    }
+  }
+
+  /*
+   * the strand length doesn't change after neo_init(), so the
+   * base frame only needs to be allocated once
+   */
+  if(rainbow_base == NULL)
+    rainbow_base = (uint8_t *)malloc(n);
+  if(rainbow_base == NULL)  {
+    DEBUG_ERROR("ERROR: neo_rainbow_start: no memory for base frame\n");
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+
+  for(uint16_t h = 0; h < NEO_RAINBOW_HUES; h++)
+    rainbow_lut[h] = pixels->ColorHSV(h << 8, sat, val);
+
+  for(uint16_t i = 0; i < n; i++)
+    rainbow_base[i] = ((uint32_t)i * spread * NEO_RAINBOW_HUES) / n;
 
-  current_millis = millis();
+  rainbow_phase = 0;
+
+  DEBUG_INFO("Starting rainbow: speed = %d, spread = %d, sat = %d, val = %d, dt = %d\n",
+              rainbow_speed, spread, sat, val, rainbow_interval);
+
+  current_millis = neo_sync_millis();
 
   neo_state = NEO_SEQ_WRITE;
 
 }
 
 /*
- * wait a fixed 10mS
+ * wait rainbow_interval mS between frames
  */
 void neo_rainbow_wait(void)  {
-  uint64_t new_millis = 0;
-
   /*
     * if the timer has expired (or assumed that if current_millis == 0, then it will be)
     * i.e. done waiting move to the next state
     */
-  if(((new_millis = millis()) - current_millis) >= 10)  {
-    current_millis = new_millis;
+  if(neo_interval_due(rainbow_interval))  {
     neo_state = NEO_SEQ_WRITE;
   }
 }
 
 /*
- * advance and write a pixel
+ * advance the hue and write the frame
  */
 void neo_rainbow_write(void) {
-  pixels->rainbow(firstPixelHue);
-  pixels->show();
+  uint16_t n = pixels->numPixels();
 
-  firstPixelHue += 256;
+  neo_px->lut8(pixels->getPixels(), n, rainbow_base, rainbow_phase, rainbow_lut);
+  pixels->show();
 
-  if(firstPixelHue >= 5*65536)
-    firstPixelHue = 0;
+  rainbow_phase += rainbow_speed;
 
   neo_state = NEO_SEQ_WAIT;
 
@@ -983,6 +1309,369 @@ void neo_rainbow_stopping(void)  {
 
 // end of SEQ_STRAT_RAINBOW callbacks
 
+/*
+ * SEQ_STRAT_STREAM
+ * per-pixel animation played frame by frame from a file in LittleFS
+ * (made with tools/neo_anim.py)
+ *
+ * file (little endian):
+ *   header: "NEOA", version (1 or 2), flags, pixels (uint16),
+ *           mS per frame (uint16), number of frames (uint16)
+ *   flags: bit 0: RLE, bit 1: 16 color palette, bit 2: 256 color palette,
+ *          bit 3: palette changes per frame (version 2 for bits 1-3)
+ *   raw frames: pixels * r, g, b
+ *   RLE frames: encoded length (uint16), then runs of
+ *           n < 0x80  : n + 1 literal r, g, b triples
+ *           n >= 0x80 : (n & 0x7F) + 1 copies of the next r, g, b
+ *
+ * palette files have the palette (16 or 256 * r, g, b) after the header and
+ * frames of palette indices, two pixels per byte (high nibble first) for 16
+ * colors or one per byte for 256, so a frame is 1/6 or 1/3 of its raw size.
+ * with bit 3 each frame starts with a count (up to NEO_ANIM_PAL_UPDATES) of
+ * palette entries to change when it's shown, then that many index, r, g, b.
+ * that's enough for color cycling and fades without touching the pixels.
+ * the palette is kept as NeoPixel colors, so showing a frame is just a
+ * table lookup per pixel on the way into the pixel writer (neo_px), and
+ * it's reloaded from the file when the animation starts over.
+ *
+ * the frames are double buffered: as soon as a frame has been shown the
+ * next one is read and decoded into the back buffer (in the first wait
+ * after the write), so it is ready well before its deadline and writing
+ * it out doesn't wait on the file system, however busy the web server is.
+ * a frame that isn't ready in time is counted as a stall.
+ *
+ * "bonus" from the json sequence file, defaults in ():
+ *   "file" : animation file name (required)
+ *   "t"    : mS per frame, overrides the file
+ *   "loop" : start over at the end (true), false stops after the last frame
+ */
+#define NEO_ANIM_MAGIC   "NEOA"
+#define NEO_ANIM_VERSION 2
+#define NEO_ANIM_RLE     0x01
+#define NEO_ANIM_PAL16   0x02
+#define NEO_ANIM_PAL256  0x04
+#define NEO_ANIM_PALANIM 0x08
+#define NEO_ANIM_CHUNK   64  // bytes read at a time while decoding RLE (and loading the palette)
+#define NEO_ANIM_PAL_UPDATES 32  // max palette changes in one frame
+
+typedef struct __attribute__((packed)) {
+  char magic[4];
+  uint8_t version;
+  uint8_t flags;
+  uint16_t pixels;
+  uint16_t interval;
+  uint16_t frames;
+} neo_anim_hdr_t;
+
+static File stream_fd;
+static neo_anim_hdr_t stream_hdr;
+static uint8_t *stream_buf[2] = { NULL, NULL };  // front/back frames (see neo_stream_frame_size())
+static uint32_t stream_size = 0;  // bytes in each of them
+static uint32_t *stream_lut = NULL;  // NeoPixel color of each palette entry
+static uint16_t stream_colors = 0;  // palette entries, 0 for r, g, b frames
+static uint8_t stream_front = 0;
+static bool stream_ready = false;  // the back buffer holds the next frame
+static bool stream_done = false;   // no more frames (not looping)
+static bool stream_loop = true;
+static uint16_t stream_frame = 0;  // next frame to read
+static uint32_t stream_interval = 33;
+static uint32_t stream_stalls = 0;
+
+/*
+ * decode one RLE frame of len bytes from the file into dst
+ */
+static bool neo_stream_rle(uint8_t *dst, uint16_t len)  {
+  uint8_t chunk[NEO_ANIM_CHUNK];
+  uint16_t have = 0, pos = 0;  // bytes in chunk, next one to use
+  uint32_t out = 0, size = (uint32_t)stream_hdr.pixels * 3;
+  uint8_t run = 0, rgb[3];
+  int16_t left = 0;     // bytes still to come for the current run
+  bool literal = false;
+
+  while((len > 0) || (pos < have))  {
+    if(pos == have)  {
+      have = fsio_read(FSIO_STREAM, stream_fd, chunk, min(len, (uint16_t)NEO_ANIM_CHUNK));
+      if(have == 0)
+        return(false);
+      len -= have;
+      pos = 0;
+    }
+    uint8_t b = chunk[pos++];
+
+    if(left == 0)  {  // start of a run
+      literal = (b < 0x80);
+      run = (b & 0x7F) + 1;
+      left = literal ? (run * 3) : 3;
+      continue;
+    }
+    if(literal)  {
+      if(out < size)
+        dst[out++] = b;
+      left--;
+    }
+    else  {
+      rgb[3 - left] = b;
+      if(--left == 0)  {
+        for(; run > 0; run--)  {
+          for(uint8_t c = 0; (c < 3) && (out < size); c++)
+            dst[out++] = rgb[c];
+        }
+      }
+    }
+  }
+  while(out < size)
+    dst[out++] = 0;  // short frame: the rest are off
+  return(true);
+}
+
+/*
+ * close the file and free the frames (also when another sequence
+ * takes over without this one being stopped)
+ */
+void neo_stream_release(void)  {
+  if(stream_fd)
+    fsio_close(FSIO_STREAM, stream_fd);
+  for(uint8_t i = 0; i < 2; i++)  {
+    free(stream_buf[i]);
+    stream_buf[i] = NULL;
+  }
+  free(stream_lut);
+  stream_lut = NULL;
+}
+
+/*
+ * (re)load the palette, which follows the header
+ */
+static bool neo_stream_palette(void)  {
+  uint8_t chunk[NEO_ANIM_CHUNK - (NEO_ANIM_CHUNK % 3)];
+  uint16_t entry = 0;
+  size_t n;
+
+  if(!stream_fd.seek(sizeof(neo_anim_hdr_t)))
+    return(false);
+  while(entry < stream_colors)  {
+    n = min((size_t)(stream_colors - entry) * 3, sizeof(chunk));
+    if(fsio_read(FSIO_STREAM, stream_fd, chunk, n) != n)
+      return(false);
+    for(size_t i = 0; i < n; i += 3)
+      stream_lut[entry++] = Adafruit_NeoPixel::Color(chunk[i], chunk[i + 1], chunk[i + 2]);
+  }
+  return(true);
+}
+
+/*
+ * bytes for one decoded frame: the palette changes (if any) and the
+ * indices, or r, g, b for each pixel
+ */
+static uint32_t neo_stream_frame_size(void)  {
+  uint32_t size;
+
+  if(stream_hdr.flags & NEO_ANIM_PAL16)
+    size = ((uint32_t)stream_hdr.pixels + 1) / 2;
+  else if(stream_hdr.flags & NEO_ANIM_PAL256)
+    size = stream_hdr.pixels;
+  else
+    size = (uint32_t)stream_hdr.pixels * 3;
+  if(stream_hdr.flags & NEO_ANIM_PALANIM)
+    size += 1 + (NEO_ANIM_PAL_UPDATES * 4);
+  return(size);
+}
+
+/*
+ * read the next frame into dst
+ * return: false at the end (not looping) or on a read error
+ */
+static bool neo_stream_read(uint8_t *dst)  {
+  uint32_t size = stream_size;
+  uint16_t len;
+
+  if(stream_frame >= stream_hdr.frames)  {
+    if(!stream_loop)
+      return(false);
+    if(stream_colors > 0)  {  // the frame on show doesn't need the palette any more
+      if(!neo_stream_palette())
+        return(false);
+    }
+    else
+      stream_fd.seek(sizeof(neo_anim_hdr_t));
+    stream_frame = 0;
+  }
+  stream_frame++;
+
+  if(stream_hdr.flags & NEO_ANIM_PALANIM)  {
+    if((fsio_read(FSIO_STREAM, stream_fd, dst, 1) != 1) || (dst[0] > NEO_ANIM_PAL_UPDATES) ||
+       (fsio_read(FSIO_STREAM, stream_fd, dst + 1, dst[0] * 4) != (size_t)(dst[0] * 4)))
+      return(false);
+    dst += 1 + (NEO_ANIM_PAL_UPDATES * 4);
+    size -= 1 + (NEO_ANIM_PAL_UPDATES * 4);
+  }
+
+  if(stream_hdr.flags & NEO_ANIM_RLE)  {
+    if(fsio_read(FSIO_STREAM, stream_fd, (uint8_t *)&len, sizeof(len)) != sizeof(len))
+      return(false);
+    return(neo_stream_rle(dst, len));
+  }
+  return(fsio_read(FSIO_STREAM, stream_fd, dst, size) == size);
+}
+
+/*
+ * the render kernel for palette frames: apply the frame's palette
+ * changes, then look each pixel's index up in the palette
+ */
+static void neo_stream_show_palette(const uint8_t *frame, uint16_t n)  {
+  const uint8_t *upd;
+
+  if(stream_hdr.flags & NEO_ANIM_PALANIM)  {
+    upd = frame + 1;
+    for(uint8_t u = 0; u < frame[0]; u++, upd += 4)  {
+      if(upd[0] < stream_colors)
+        stream_lut[upd[0]] = Adafruit_NeoPixel::Color(upd[1], upd[2], upd[3]);
+    }
+    frame += 1 + (NEO_ANIM_PAL_UPDATES * 4);
+  }
+
+  if(stream_colors == 16)
+    neo_px->lut4(pixels->getPixels(), n, frame, stream_lut);
+  else
+    neo_px->lut8(pixels->getPixels(), n, frame, 0, stream_lut);
+}
+
+static void neo_stream_show(const uint8_t *frame)  {
+  uint16_t fpix = stream_hdr.pixels;
+  uint16_t n = min(pixels->numPixels(), fpix);
+
+  if(stream_colors > 0)
+    neo_stream_show_palette(frame, n);
+  else
+    neo_px->rgb(pixels->getPixels(), 0, n, frame);
+  pixels->show();
+}
+
+void neo_stream_start(bool clear)  {
+  JsonDocument jsonDoc(json_pool());
+  DeserializationError err;
+  char bonus[MAX_NEO_BONUS];  // copy of the bonus (may come from flash)
+  const char *file = NULL;
+
+  pixels->clear();
+  pixels->show();
+
+  neo_stream_release();  // in case the last stream was replaced rather than stopped
+  stream_loop = true;
+  stream_interval = 0;
+  stream_stalls = 0;
+
+  neo_get_bonus(seq_index, bonus);
+  err = deserializeJson(jsonDoc, bonus);
+  if(err || ((file = jsonDoc["file"]) == NULL))  {
+    DEBUG_ERROR("ERROR: neo_stream_start: bonus needs at least {\"file\" : name}\n");
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+  stream_loop = jsonDoc["loop"] | true;
+  stream_interval = jsonDoc["t"] | 0;
+
+  if(!(stream_fd = fsio_open(FSIO_STREAM, file, "r")) ||
+     (fsio_read(FSIO_STREAM, stream_fd, (uint8_t *)&stream_hdr, sizeof(stream_hdr)) != sizeof(stream_hdr)) ||
+     (memcmp(stream_hdr.magic, NEO_ANIM_MAGIC, 4) != 0) ||
+     (stream_hdr.version < 1) || (stream_hdr.version > NEO_ANIM_VERSION) ||
+     (stream_hdr.pixels == 0) || (stream_hdr.frames == 0))  {
+    DEBUG_ERROR("ERROR: neo_stream_start: %s is missing or not an animation file\n", file);
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+
+  /*
+   * one of r, g, b (maybe RLE), 16 colors or 256 colors
+   */
+  stream_colors = (stream_hdr.flags & NEO_ANIM_PAL16) ? 16 : ((stream_hdr.flags & NEO_ANIM_PAL256) ? 256 : 0);
+  if(((stream_hdr.flags & NEO_ANIM_PAL16) && (stream_hdr.flags & NEO_ANIM_PAL256)) ||
+     ((stream_colors > 0) && (stream_hdr.flags & NEO_ANIM_RLE)) ||
+     ((stream_colors == 0) && (stream_hdr.flags & NEO_ANIM_PALANIM)))  {
+    DEBUG_ERROR("ERROR: neo_stream_start: %s has an unknown mix of flags (0x%02x)\n", file, stream_hdr.flags);
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+  if(stream_interval == 0)
+    stream_interval = stream_hdr.interval;
+
+  stream_size = neo_stream_frame_size();
+  for(uint8_t i = 0; i < 2; i++)
+    stream_buf[i] = (uint8_t *)malloc(stream_size);
+  if(stream_colors > 0)
+    stream_lut = (uint32_t *)malloc(stream_colors * sizeof(uint32_t));
+  if((stream_buf[0] == NULL) || (stream_buf[1] == NULL) || ((stream_colors > 0) && (stream_lut == NULL)))  {
+    DEBUG_ERROR("ERROR: neo_stream_start: no memory for %d pixel frames\n", stream_hdr.pixels);
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+  if((stream_colors > 0) && !neo_stream_palette())  {
+    DEBUG_ERROR("ERROR: neo_stream_start: %s: can't read the palette\n", file);
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+
+  DEBUG_INFO("Starting stream: %s, %d pixels, %d frames, %d mS/frame%s, %d colors%s\n", file, stream_hdr.pixels,
+             stream_hdr.frames, stream_interval, (stream_hdr.flags & NEO_ANIM_RLE ? ", RLE" : ""),
+             stream_colors, (stream_hdr.flags & NEO_ANIM_PALANIM ? " (animated)" : ""));
+
+  /*
+   * show the first frame and have the second one ready
+   */
+  stream_frame = 0;
+  stream_front = 0;
+  stream_done = false;
+  if(!neo_stream_read(stream_buf[stream_front]))  {
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+  neo_stream_show(stream_buf[stream_front]);
+  stream_ready = neo_stream_read(stream_buf[stream_front ^ 1]);
+  stream_done = !stream_ready;
+
+  current_millis = neo_sync_millis();
+  neo_state = NEO_SEQ_WAIT;
+}
+
+/*
+ * read ahead if the back buffer is empty, then wait for the deadline
+ */
+void neo_stream_wait(void)  {
+  if(!stream_ready && !stream_done)  {
+    stream_ready = neo_stream_read(stream_buf[stream_front ^ 1]);
+    stream_done = !stream_ready;
+  }
+  if(neo_interval_due(stream_interval))
+    neo_state = NEO_SEQ_WRITE;
+}
+
+void neo_stream_write(void)  {
+  if(!stream_ready && !stream_done)  {  // missed the read-ahead (shouldn't happen)
+    stream_stalls++;
+    stream_ready = neo_stream_read(stream_buf[stream_front ^ 1]);
+    stream_done = !stream_ready;
+  }
+  if(!stream_ready)  {  // that was the last one
+    neo_state = NEO_SEQ_STOPPING;
+    return;
+  }
+
+  stream_front ^= 1;
+  stream_ready = false;
+  neo_stream_show(stream_buf[stream_front]);
+  neo_state = NEO_SEQ_WAIT;
+}
+
+void neo_stream_stopping(void)  {
+  neo_stream_release();
+  if(stream_stalls > 0)
+    DEBUG_INFO("neo_stream: %d frames weren't ready in time\n", stream_stalls);
+
+  neo_points_stopping();
+}
+
+// end of SEQ_STRAT_STREAM callbacks
+
 /*
  * function calls by strategy for each state in the playback machine
  * TODO: delete the 'x' before the labels after implementing a strategy
@@ -995,6 +1684,7 @@ seq_callbacks_t seq_callbacks[NEO_SEQ_STRATEGIES] = {
   { SEQ_STRAT_PONG,      "pong",           neo_pong_start,    neo_slowp_wait,    neo_pong_write,      neo_points_stopping,      noop},
   { SEQ_STRAT_RAINBOW,   "rainbow",       neo_rainbow_start, neo_rainbow_wait,  neo_rainbow_write,    neo_rainbow_stopping,     noop},
   { SEQ_STRAT_SLOWP,     "slowp",          neo_slowp_start,   neo_slowp_wait,    neo_slowp_write,     neo_points_stopping,      noop},
+  { SEQ_STRAT_STREAM,    "stream",         neo_stream_start,  neo_stream_wait,   neo_stream_write,    neo_stream_stopping,      noop},
 };
 
 /*
@@ -1045,6 +1735,7 @@ void neo_cycle_next(void)  {
     default:
       break;
   }
+  neo_dither_service();
 }
 
 /*
@@ -1053,4 +1744,37 @@ void neo_cycle_next(void)  {
 void neo_cycle_stop(void)  {
   neo_state = NEO_SEQ_STOPPING;
   seq_index = -1;  // so it doesn't match
-}
\ No newline at end of file
+}
+
+/*
+ * start the current sequence over from the beginning
+ * (e.g. after something else has been writing to the strand),
+ * or just blank the strand if nothing is playing
+ */
+void neo_restart(void)  {
+  dither_live = false;
+  if(seq_index >= 0)  {
+    current_index = 0;
+    neo_state = NEO_SEQ_START;
+  }
+  else  {
+    pixels->clear();
+    pixels->show();
+  }
+}
+
+/*
+ * heap taken by the strand and the frames of the strategies that have
+ * them (reported in /$memory)
+ */
+uint32_t neo_heap_bytes(void)  {
+  uint32_t n;
+
+  if(pixels == NULL)
+    return(0);
+  n = pixels->numPixels();
+  return(sizeof(Adafruit_NeoPixel) + (n * neo_px->bpp) + neo_px_dither_bytes() +
+         ((rainbow_base != NULL) ? n : 0) +
+         ((stream_buf[0] != NULL) ? (2 * stream_size) : 0) +
+         ((stream_lut != NULL) ? (stream_colors * sizeof(uint32_t)) : 0));
+}
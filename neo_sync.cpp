@@ -0,0 +1,258 @@
+/*
+ * multi-board clock synchronization (see neo_sync.h)
+ *
+ * shared clock:  shared(local) = local + offset + skew * (local - ref)
+ * local is micros64() on each board, the leader's shared clock is its
+ * local clock.
+ *
+ * beacon received at local time L carrying leader time T:
+ *   err = T - shared(L) is the model error minus the network delay.
+ *   the beacon with the biggest err in each window of NEO_SYNC_WINDOW
+ *   is the least delayed one, and only it is used: half of its error goes
+ *   into the offset (phase) and a sixteenth of its rate into the skew
+ *   (frequency).  the delay that's left is about the same for all
+ *   followers on the same network, so they stay in step with each other
+ *   (and within a mS or so of the leader).
+ *
+ * the sequence timing in neo_play.cpp runs from neo_sync_millis(), and
+ * commands sent with neo_sync_play() start at the same shared time on every
+ * board, so a sequence started that way stays phase-locked.
+ * with the role set to none, neo_sync_millis() is just the local clock and
+ * commands are played on the next loop().
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "bt_loglib.h"
+#include "neo_sync.h"
+
+#define NEO_SYNC_MAGIC  0x3159534E  // "NSY1"
+
+typedef enum {
+  SYNC_MSG_BEACON,
+  SYNC_MSG_PLAY,
+} sync_msg_type_t;
+
+/*
+ * everything on the wire is little endian (both ends are ESP8266s or the
+ * test tool, which packs it the same way)
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint8_t type;
+  uint8_t pad;
+  uint16_t seq;
+  uint32_t sender;      // chip id, to skip our own broadcasts
+  int64_t time_us;      // beacon: leader clock, play: shared start time
+  char label[MAX_NEO_LABEL];
+  char file[NEO_SYNC_MAX_FILE];
+} sync_msg_t;
+
+static WiFiUDP sync_udp;
+static neo_sync_stats_t sync_stats;
+static int8_t (*sync_play_cb)(const char *seq, const char *file) = NULL;
+
+static int64_t sync_ref_us = 0;     // local time the offset applies at
+static uint16_t sync_seq = 0;       // sent message count
+static uint32_t sync_last_beacon = 0;
+
+static uint8_t win_count = 0;       // beacons in the current window
+static int64_t win_start_us = 0;    // local time of the first
+static int64_t win_max_err = 0;     // least delayed beacon's error
+
+/*
+ * one command waiting for its start time
+ */
+static struct {
+  bool pending;
+  int64_t at_us;  // shared time
+  char label[MAX_NEO_LABEL];
+  char file[NEO_SYNC_MAX_FILE];
+} sync_cmd;
+
+static int64_t sync_shared_us(int64_t local)  {
+  return(local + sync_stats.offset_us + (int64_t)(sync_stats.skew * (float)(local - sync_ref_us)));
+}
+
+uint64_t neo_sync_millis(void)  {
+  return((uint64_t)(sync_shared_us((int64_t)micros64()) / 1000));
+}
+
+neo_sync_role_t neo_sync_role(const char *srole)  {
+  if(strcmp(srole, "leader") == 0)
+    return(NEO_SYNC_LEADER);
+  if(strcmp(srole, "follower") == 0)
+    return(NEO_SYNC_FOLLOWER);
+  return(NEO_SYNC_NONE);
+}
+
+static void sync_send(sync_msg_type_t type, int64_t time_us, const char *label, const char *file)  {
+  sync_msg_t msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.magic = NEO_SYNC_MAGIC;
+  msg.type = type;
+  msg.seq = sync_seq++;
+  msg.sender = ESP.getChipId();
+  msg.time_us = time_us;
+  if(label != NULL)
+    strncpy(msg.label, label, sizeof(msg.label) - 1);
+  if(file != NULL)
+    strncpy(msg.file, file, sizeof(msg.file) - 1);
+
+  sync_udp.beginPacket(WiFi.broadcastIP(), NEO_SYNC_PORT);
+  sync_udp.write((const uint8_t *)&msg, sizeof(msg));
+  sync_udp.endPacket();
+}
+
+static void sync_schedule(int64_t at_us, const char *label, const char *file)  {
+  sync_cmd.at_us = at_us;
+  strncpy(sync_cmd.label, label, sizeof(sync_cmd.label) - 1);
+  sync_cmd.label[sizeof(sync_cmd.label) - 1] = '\0';
+  strncpy(sync_cmd.file, file, sizeof(sync_cmd.file) - 1);
+  sync_cmd.file[sizeof(sync_cmd.file) - 1] = '\0';
+  sync_cmd.pending = true;
+}
+
+/*
+ * step the clock to the beacon (first one, or too far off to slew)
+ * the sequence that's playing is restarted so its timing
+ * isn't left behind on the old clock
+ */
+static void sync_step(int64_t leader_us, int64_t local_us)  {
+  sync_stats.offset_us = leader_us - local_us;
+  sync_ref_us = local_us;
+  sync_stats.locked = true;
+  sync_stats.steps++;
+  win_count = 0;
+  DEBUG_INFO("neo_sync: clock stepped, offset %d mS\n", (int)(sync_stats.offset_us / 1000));
+  neo_restart();
+}
+
+static void sync_beacon(int64_t leader_us, int64_t local_us)  {
+  int64_t err;
+
+  sync_stats.beacons++;
+  if(!sync_stats.locked)  {
+    sync_step(leader_us, local_us);
+    return;
+  }
+
+  err = leader_us - sync_shared_us(local_us);
+  if(win_count == 0)  {
+    win_start_us = local_us;
+    win_max_err = err;
+  }
+  else if(err > win_max_err)
+    win_max_err = err;
+
+  if(++win_count < NEO_SYNC_WINDOW)
+    return;
+
+  /*
+   * end of the window: correct with the least delayed beacon
+   */
+  win_count = 0;
+  sync_stats.last_err_us = (int32_t)win_max_err;
+  if((win_max_err > NEO_SYNC_STEP_US) || (win_max_err < -NEO_SYNC_STEP_US))  {
+    sync_step(leader_us, local_us);
+    return;
+  }
+  sync_stats.offset_us = sync_shared_us(local_us) - local_us;  // move ref up to now
+  sync_ref_us = local_us;
+  sync_stats.offset_us += win_max_err / 2;
+  if(local_us > win_start_us)
+    sync_stats.skew += ((float)win_max_err / (float)(local_us - win_start_us)) / 16.0f;
+}
+
+/*
+ * role: from the configuration
+ * play: plays a sequence (or STOP) right away, called from loop() when a
+ *       command's start time comes (the next loop() without sync)
+ */
+void neo_sync_begin(neo_sync_role_t role, int8_t (*play)(const char *seq, const char *file))  {
+  sync_stats.role = role;
+  sync_stats.locked = (role == NEO_SYNC_LEADER);  // the leader's clock is the shared one
+  sync_play_cb = play;
+
+  if(role != NEO_SYNC_NONE)  {
+    sync_udp.begin(NEO_SYNC_PORT);
+    DEBUG_INFO("neo_sync: %s on port %d\n", (role == NEO_SYNC_LEADER ? "leader" : "follower"), NEO_SYNC_PORT);
+  }
+}
+
+/*
+ * play seq (with file for user sequences) on every board:
+ * broadcast it with a start time NEO_SYNC_LEAD_MS from now and schedule it here too.
+ * without sync it's scheduled for now, so it's played on the next loop().
+ * it's called from the web server callbacks, so loading and playing the
+ * sequence is always left to neo_sync_service().
+ */
+int8_t neo_sync_play(const char *seq, const char *file)  {
+  int64_t at_us;
+
+  if(file == NULL)
+    file = "";
+  if(sync_stats.role == NEO_SYNC_NONE)  {
+    sync_schedule(sync_shared_us((int64_t)micros64()), seq, file);
+    return(NEO_SUCCESS);
+  }
+
+  at_us = sync_shared_us((int64_t)micros64()) + (int64_t)NEO_SYNC_LEAD_MS * 1000;
+  sync_send(SYNC_MSG_PLAY, at_us, seq, file);
+  sync_schedule(at_us, seq, file);
+  return(NEO_SUCCESS);
+}
+
+/*
+ * beacons and incoming commands
+ */
+static void sync_receive(void)  {
+  sync_msg_t msg;
+  int64_t now;
+
+  while(sync_udp.parsePacket() > 0)  {
+    now = (int64_t)micros64();  // as close to the arrival as possible
+    if((sync_udp.read((uint8_t *)&msg, sizeof(msg)) != sizeof(msg)) ||
+       (msg.magic != NEO_SYNC_MAGIC) || (msg.sender == ESP.getChipId()))
+      continue;
+    msg.label[sizeof(msg.label) - 1] = '\0';
+    msg.file[sizeof(msg.file) - 1] = '\0';
+
+    if(msg.type == SYNC_MSG_BEACON)  {
+      if(sync_stats.role == NEO_SYNC_FOLLOWER)
+        sync_beacon(msg.time_us, now);
+    }
+    else if(msg.type == SYNC_MSG_PLAY)  {
+      DEBUG_INFO("neo_sync: play %s in %d mS\n", msg.label, (int)((msg.time_us - sync_shared_us(now)) / 1000));
+      sync_schedule(msg.time_us, msg.label, msg.file);
+    }
+  }
+
+  if((sync_stats.role == NEO_SYNC_LEADER) && ((millis() - sync_last_beacon) >= NEO_SYNC_BEACON_MS))  {
+    sync_last_beacon = millis();
+    sync_send(SYNC_MSG_BEACON, (int64_t)micros64(), NULL, NULL);
+    sync_stats.beacons++;
+  }
+}
+
+/*
+ * called from loop(): beacons, incoming commands and starting a
+ * scheduled command when its time comes
+ */
+void neo_sync_service(void)  {
+  if(sync_stats.role != NEO_SYNC_NONE)
+    sync_receive();
+
+  if(sync_cmd.pending && (sync_play_cb != NULL) && (sync_shared_us((int64_t)micros64()) >= sync_cmd.at_us))  {
+    sync_cmd.pending = false;
+    if(sync_play_cb(sync_cmd.label, sync_cmd.file) != NEO_SUCCESS)
+      DEBUG_ERROR("ERROR: neo_sync: couldn't play %s\n", sync_cmd.label);
+  }
+}
+
+const neo_sync_stats_t *neo_sync_get_stats(void)  {
+  return(&sync_stats);
+}
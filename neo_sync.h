@@ -0,0 +1,49 @@
+/*
+ * keeping the sequences on several boards in step
+ *
+ * one board (the leader) broadcasts its clock; the followers estimate
+ * their offset and drift from it so that every board has the same
+ * "shared" clock.  the sequence timing runs from the shared clock and
+ * play/stop commands are broadcast with a start time a little in the
+ * future, so all of the boards start (and stay) together.
+ */
+#ifndef __NEO_SYNC_H__
+
+#include <c_types.h>
+#include "neo_data.h"
+
+#define NEO_SYNC_PORT       4210     // udp port for beacons and commands
+#define NEO_SYNC_BEACON_MS  1000     // leader beacon interval
+#define NEO_SYNC_WINDOW     8        // beacons per correction (the least delayed one is used)
+#define NEO_SYNC_STEP_US    50000    // errors bigger than this step the clock instead of slewing it
+#define NEO_SYNC_LEAD_MS    250      // commands start this far in the future
+#define NEO_SYNC_MAX_FILE   32       // max chars in a file name in a command
+
+typedef enum {
+  NEO_SYNC_NONE,      // stand alone, commands play on the next loop()
+  NEO_SYNC_LEADER,    // sends the clock
+  NEO_SYNC_FOLLOWER,  // follows the leader's clock
+} neo_sync_role_t;
+
+/*
+ * state of the follower's estimate, reported in /$netinfo
+ */
+typedef struct {
+  neo_sync_role_t role;
+  bool locked;         // a beacon has been heard
+  int64_t offset_us;   // shared - local at ref_us
+  float skew;          // drift of the shared clock relative to local (e.g. 20e-6 = 20 ppm)
+  int32_t last_err_us; // error of the last correction (least delayed beacon in the window)
+  uint32_t beacons;    // beacons received (or sent by the leader)
+  uint32_t steps;      // times the clock was stepped
+} neo_sync_stats_t;
+
+neo_sync_role_t neo_sync_role(const char *srole);
+void neo_sync_begin(neo_sync_role_t role, int8_t (*play)(const char *seq, const char *file));
+void neo_sync_service(void);
+int8_t neo_sync_play(const char *seq, const char *file);
+uint64_t neo_sync_millis(void);
+const neo_sync_stats_t *neo_sync_get_stats(void);
+
+#define __NEO_SYNC_H__
+#endif
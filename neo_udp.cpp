@@ -0,0 +1,251 @@
+/*
+ * real-time pixel streaming over UDP
+ *
+ * DDP:   http://www.3waylabs.com/ddp/
+ *        10 byte header (14 with a timecode), data at a byte offset into
+ *        the strand, shown when the PUSH flag is set.
+ * E1.31: ANSI E1.31 (sACN), 126 byte header, 510 channels (170 RGB pixels)
+ *        per universe starting at NEO_E131_UNIVERSE, shown once all of the
+ *        pending packets have been read.
+ *
+ * pixel data is read out of the UDP buffer straight into the strand's
+ * pixel buffer when the strand is RGB ordered and the brightness isn't
+ * scaled, otherwise through the pixel writers (neo_pixel.cpp) a few
+ * pixels at a time.
+ * streamed colors are used as they are (no gamma, senders do their own).
+ */
+#include <Arduino.h>
+#include <Arduino_DebugUtils.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "bt_loglib.h"
+#include "neo_data.h"
+#include "neo_pixel.h"
+#include "neo_udp.h"
+
+extern Adafruit_NeoPixel *pixels;
+
+static WiFiUDP ddp_udp;
+static WiFiUDP e131_udp;
+
+static neo_udp_stats_t udp_stats;
+static bool udp_direct = false;     // strand buffer is in packet (RGB) order
+static bool udp_streaming = false;  // stream owns the strand
+static uint32_t udp_last_rx = 0;    // millis() of the last good packet
+
+static uint8_t ddp_last_seq = 0;                   // 0: none yet
+static uint8_t e131_last_seq[NEO_E131_MAX_UNIV];
+static bool e131_seen[NEO_E131_MAX_UNIV];
+
+#define DDP_HDR_LEN     10
+#define DDP_TC_LEN       4
+#define DDP_FLAG_VER    0xC0
+#define DDP_VER1        0x40
+#define DDP_FLAG_TC     0x10
+#define DDP_FLAG_QUERY  0x02
+#define DDP_FLAG_PUSH   0x01
+#define DDP_ID_DISPLAY  1
+
+#define E131_HDR_LEN    126
+#define E131_UNIV_CHAN  510
+
+#define UDP_CHUNK_PIXELS 32  // pixels per read when going through the pixel writers
+
+/*
+ * sequence number checks
+ * ahead by a little: the ones in between were dropped
+ * behind: this one is late (a newer one was already shown), skip it
+ */
+static bool udp_seq_ok(uint16_t seq, uint16_t last, uint16_t modulo)  {
+  uint16_t gap = (seq + modulo - last - 1) % modulo;  // 0 when seq == last + 1
+
+  if(gap >= (modulo / 2))  {
+    udp_stats.late++;
+    return(false);
+  }
+  udp_stats.dropped += gap;
+  return(true);
+}
+
+/*
+ * read len bytes of RGB pixel data for the strand starting at byte offset
+ */
+static void udp_read_pixels(WiFiUDP &udp, uint32_t offset, uint32_t len)  {
+  uint32_t strand = (uint32_t)pixels->numPixels() * 3;
+  uint8_t rgb[UDP_CHUNK_PIXELS * 3];
+
+  if(offset >= strand)
+    return;
+  if((offset + len) > strand)
+    len = strand - offset;
+
+  if(udp_direct)  {
+    udp.read(pixels->getPixels() + offset, len);  // no copy, packet to strand buffer
+    return;
+  }
+
+  /*
+   * not in strand order (or scaled): a chunk at a time through the writers
+   * (offset is rounded to a whole pixel)
+   */
+  uint16_t pix = offset / 3;
+  while(len >= 3)  {
+    int n = udp.read(rgb, min(len - (len % 3), (uint32_t)sizeof(rgb)));
+    if(n < 3)
+      break;
+    neo_px_nogamma->rgb(pixels->getPixels(), pix, n / 3, rgb);
+    pix += n / 3;
+    len -= n;
+  }
+}
+
+/*
+ * one DDP packet
+ * return: true if the frame should be shown now
+ */
+static bool udp_ddp_packet(void)  {
+  uint8_t hdr[DDP_HDR_LEN + DDP_TC_LEN];
+  uint8_t hlen = DDP_HDR_LEN;
+  uint32_t offset;
+  uint16_t len;
+
+  if(ddp_udp.read(hdr, DDP_HDR_LEN) != DDP_HDR_LEN)  {
+    udp_stats.bad++;
+    return(false);
+  }
+  if(((hdr[0] & DDP_FLAG_VER) != DDP_VER1) || (hdr[0] & DDP_FLAG_QUERY) ||
+     (hdr[3] != DDP_ID_DISPLAY) || (((hdr[2] >> 3) & 0x07) > 1))  {  // only undefined/RGB data
+    udp_stats.bad++;
+    return(false);
+  }
+  if(hdr[0] & DDP_FLAG_TC)  {
+    ddp_udp.read(hdr + DDP_HDR_LEN, DDP_TC_LEN);  // timecode isn't used
+    hlen += DDP_TC_LEN;
+  }
+
+  /*
+   * 4 bit sequence number counting 1 .. 15, 0 means the sender doesn't use them
+   */
+  if((hdr[1] & 0x0F) != 0)  {
+    if((ddp_last_seq != 0) && !udp_seq_ok((hdr[1] & 0x0F) - 1, ddp_last_seq - 1, 15))
+      return(false);
+    ddp_last_seq = hdr[1] & 0x0F;
+  }
+
+  offset = ((uint32_t)hdr[4] << 24) | ((uint32_t)hdr[5] << 16) | ((uint32_t)hdr[6] << 8) | hdr[7];
+  len = ((uint16_t)hdr[8] << 8) | hdr[9];
+  udp_read_pixels(ddp_udp, offset, len);
+  udp_stats.rx++;
+
+  return((hdr[0] & DDP_FLAG_PUSH) != 0);
+}
+
+/*
+ * one E1.31 data packet
+ * return: true if pixel data was written
+ */
+static bool udp_e131_packet(void)  {
+  static const uint8_t acn_id[] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+  uint8_t hdr[E131_HDR_LEN];
+  uint16_t universe, count, u;
+  uint32_t offset;
+
+  if((e131_udp.read(hdr, E131_HDR_LEN) != E131_HDR_LEN) ||
+     (memcmp(hdr + 4, acn_id, sizeof(acn_id)) != 0) ||
+     (hdr[125] != 0))  {  // DMX start code 0 only
+    udp_stats.bad++;
+    return(false);
+  }
+
+  universe = ((uint16_t)hdr[113] << 8) | hdr[114];
+  count = (((uint16_t)hdr[123] << 8) | hdr[124]);  // includes the start code
+  if((universe < NEO_E131_UNIVERSE) || (count < 1))  {
+    udp_stats.bad++;
+    return(false);
+  }
+  u = universe - NEO_E131_UNIVERSE;
+  offset = (uint32_t)u * E131_UNIV_CHAN;
+  if(offset >= ((uint32_t)pixels->numPixels() * 3))  {  // a universe past the end of the strand
+    udp_stats.bad++;
+    return(false);
+  }
+
+  if(u < NEO_E131_MAX_UNIV)  {
+    if(e131_seen[u] && !udp_seq_ok(hdr[111], e131_last_seq[u], 256))
+      return(false);
+    e131_seen[u] = true;
+    e131_last_seq[u] = hdr[111];
+  }
+
+  udp_read_pixels(e131_udp, offset, min((uint16_t)(count - 1), (uint16_t)E131_UNIV_CHAN));
+  udp_stats.rx++;
+  return(true);
+}
+
+void neo_udp_begin(neoPixelType pixelFormat)  {
+  /*
+   * the strand buffer can be filled straight from the packets only if
+   * it's 3 bytes per pixel in RGB order (RGBW strands get white off)
+   */
+  udp_direct = ((pixelFormat & 0xFF) == NEO_RGB);
+
+  ddp_udp.begin(NEO_DDP_PORT);
+  e131_udp.begin(NEO_E131_PORT);
+  DEBUG_INFO("neo_udp: listening for DDP on %d and E1.31 on %d (%s)\n", NEO_DDP_PORT, NEO_E131_PORT,
+             (udp_direct ? "direct" : "converted"));
+}
+
+/*
+ * called from loop(): read whatever has arrived and show it
+ * return: true while the stream owns the strand (don't run the sequences)
+ */
+bool neo_udp_service(void)  {
+  bool show = false;
+  uint32_t rx = udp_stats.rx;
+  int8_t n;
+
+  if(pixels == NULL)
+    return(false);
+
+  /*
+   * can't go straight into the strand buffer while it is scaled by the brightness
+   */
+  bool direct = udp_direct;
+  if(pixels->getBrightness() != 255)
+    udp_direct = false;
+
+  for(n = 0; (n < NEO_UDP_MAX_PKTS) && (ddp_udp.parsePacket() > 0); n++)  {
+    if(udp_ddp_packet())  {
+      pixels->show();
+      udp_stats.frames++;
+    }
+  }
+  for(n = 0; (n < NEO_UDP_MAX_PKTS) && (e131_udp.parsePacket() > 0); n++)  {
+    show = udp_e131_packet() || show;
+  }
+  if(show)  {
+    pixels->show();
+    udp_stats.frames++;
+  }
+  udp_direct = direct;
+
+  if(udp_stats.rx != rx)  {
+    if(!udp_streaming)
+      DEBUG_INFO("neo_udp: stream started, sequences on hold\n");
+    udp_streaming = true;
+    udp_last_rx = millis();
+  }
+  else if(udp_streaming && ((millis() - udp_last_rx) > NEO_UDP_TIMEOUT))  {
+    DEBUG_INFO("neo_udp: stream timed out, back to the sequences\n");
+    udp_streaming = false;
+    ddp_last_seq = 0;
+    memset(e131_seen, 0, sizeof(e131_seen));
+    neo_restart();
+  }
+  return(udp_streaming);
+}
+
+const neo_udp_stats_t *neo_udp_get_stats(void)  {
+  return(&udp_stats);
+}
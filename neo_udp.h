@@ -0,0 +1,36 @@
+/*
+ * real-time pixel streaming over UDP (DDP and E1.31/sACN)
+ *
+ * while packets are arriving the stream owns the strand and the sequence
+ * engine is held off; NEO_UDP_TIMEOUT mS after the last packet the sequence
+ * that was playing is restarted.
+ */
+#ifndef __NEO_UDP_H__
+
+#include <c_types.h>
+#include <Adafruit_NeoPixel.h>
+
+#define NEO_DDP_PORT       4048   // DDP (xLights, WLED, ...)
+#define NEO_E131_PORT      5568   // E1.31/sACN (unicast)
+#define NEO_E131_UNIVERSE  1      // first universe, the strand continues into the next ones
+#define NEO_E131_MAX_UNIV  8      // universes tracked for sequence numbers (170 RGB pixels each)
+#define NEO_UDP_TIMEOUT    2500   // mS without packets before going back to the sequences
+#define NEO_UDP_MAX_PKTS   8      // max packets handled per call, so loop() keeps running
+
+/*
+ * packet counters, reported in /$netinfo
+ */
+typedef struct {
+  uint32_t rx;       // packets used
+  uint32_t late;     // arrived after a newer one (out of order), discarded
+  uint32_t dropped;  // never arrived (gaps in the sequence numbers)
+  uint32_t bad;      // not understood (wrong header, data type, ...)
+  uint32_t frames;   // frames shown
+} neo_udp_stats_t;
+
+void neo_udp_begin(neoPixelType pixelFormat);
+bool neo_udp_service(void);
+const neo_udp_stats_t *neo_udp_get_stats(void);
+
+#define __NEO_UDP_H__
+#endif
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# pack webpages/ into webbundle.h so the pages are served straight out of
+# the firmware (see WebBundleHandler in MechWarriorsWebNeopixels.ino)
+#
+#   tools/make_webbundle.py [webpages directory] [output header]
+#
+# run it before building; the sketch only uses the bundle when webbundle.h
+# exists, so without this step everything is served from LittleFS as before.
+# a file uploaded to LittleFS with the same name (or name.gz) overrides
+# the bundled copy.
+#
+# text assets are stored gzip'ed, already compressed ones (png, woff2) as
+# they are.  each entry gets an ETag made from its content so the browser
+# can revalidate without anything being sent but the headers.
+#
+
+import gzip
+import hashlib
+import os
+import sys
+
+TYPES = {
+    '.htm':   'text/html',
+    '.html':  'text/html',
+    '.js':    'application/javascript',
+    '.css':   'text/css',
+    '.json':  'application/json',
+    '.svg':   'image/svg+xml',
+    '.png':   'image/png',
+    '.ico':   'image/x-icon',
+    '.woff2': 'font/woff2',
+}
+COMPRESS = ('.htm', '.html', '.js', '.css', '.json', '.svg')
+IMMUTABLE = ('.png', '.woff2')  # same as STATIC_IMMUTABLE files in the sketch
+
+here = os.path.dirname(os.path.abspath(__file__))
+src = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, '..', 'webpages')
+out = sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, '..', 'webbundle.h')
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('  ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '\n'.join(lines)
+
+
+entries = []
+body = []
+for n, name in enumerate(sorted(os.listdir(src))):
+    ext = os.path.splitext(name)[1].lower()
+    if ext not in TYPES:
+        continue
+    with open(os.path.join(src, name), 'rb') as f:
+        raw = f.read()
+    zipped = ext in COMPRESS
+    data = gzip.compress(raw, 9, mtime=0) if zipped else raw
+    etag = '"%s"' % hashlib.sha1(raw).hexdigest()[:16]
+    cache = 'public, max-age=31536000, immutable' if ext in IMMUTABLE else 'no-cache'
+
+    body.append('// %s: %d bytes, %d in the bundle' % (name, len(raw), len(data)))
+    body.append('static const char wb_path_%d[] PROGMEM = "/%s";' % (n, name))
+    body.append('static const char wb_type_%d[] PROGMEM = "%s";' % (n, TYPES[ext]))
+    body.append('static const char wb_etag_%d[] PROGMEM = "%s";' % (n, etag.replace('"', '\\"')))
+    body.append('static const char wb_cache_%d[] PROGMEM = "%s";' % (n, cache))
+    body.append('static const uint8_t wb_data_%d[] PROGMEM = {\n%s\n};\n' % (n, c_bytes(data)))
+    entries.append('  { wb_path_%d, wb_type_%d, wb_etag_%d, wb_cache_%d, wb_data_%d, %d, %s },'
+                   % (n, n, n, n, n, len(data), 'true' if zipped else 'false'))
+
+with open(out, 'w') as f:
+    f.write('''/*
+ * web pages built into the firmware
+ * GENERATED by tools/make_webbundle.py from webpages/ ... do not edit
+ */
+#ifndef __WEBBUNDLE_H__
+
+typedef struct {
+  const char *path;     // url, all strings are in flash
+  const char *type;     // content type
+  const char *etag;     // quoted ETag
+  const char *cache;    // Cache-Control
+  const uint8_t *data;
+  uint32_t len;
+  bool gzip;            // data is gzip'ed (send Content-Encoding: gzip)
+} web_asset_t;
+
+''')
+    f.write('\n'.join(body))
+    f.write('\n#define WEB_BUNDLE_COUNT %d\n\n' % len(entries))
+    f.write('static const web_asset_t web_bundle[WEB_BUNDLE_COUNT] PROGMEM = {\n')
+    f.write('\n'.join(entries))
+    f.write('\n};\n\n#define __WEBBUNDLE_H__\n#endif\n')
+
+print('%s: %d files' % (out, len(entries)))
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+#
+# make animation files for the "stream" strategy (see SEQ_STRAT_STREAM in neo_play.cpp)
+#
+#   tools/neo_anim.py encode <in.rgb> <out.neo> --pixels N [--ms 33] [--rle | --palette 16|256]
+#       in.rgb is raw 8 bit r, g, b, one frame of N pixels after another, e.g. from
+#       ffmpeg -i clip.mp4 -vf scale=300:1 -f rawvideo -pix_fmt rgb24 clip.rgb
+#       --palette stores palette indices instead of r, g, b (the most used colors,
+#       everything else goes to the nearest one)
+#
+#   tools/neo_anim.py demo <out.neo> [--pixels 300] [--frames 90] [--ms 33] [--rle | --palette 16|256 [--cycle]]
+#       a test clip: a comet with a fading tail over a dim background
+#       --cycle makes the background pulse by changing its palette entry every frame
+#
+#   tools/neo_anim.py info <file.neo>
+#
+# upload the .neo file with $upload.htm and point a sequence file at it:
+#   { "label" : "USER-3", "strategy" : "stream", "bonus" : { "file" : "/clip.neo" }, "points" : [] }
+#
+
+import argparse
+import collections
+import math
+import struct
+import sys
+
+HDR = struct.Struct('<4sBBHHH')
+MAGIC = b'NEOA'
+VERSION = 2
+RLE = 0x01
+PAL16 = 0x02
+PAL256 = 0x04
+PALANIM = 0x08
+PAL_UPDATES = 32  # max palette changes in a frame (NEO_ANIM_PAL_UPDATES)
+
+
+def rle_frame(frame):
+    """runs: n < 0x80 -> n+1 literal pixels, n >= 0x80 -> (n & 0x7f)+1 copies of one pixel"""
+    px = [bytes(frame[i:i + 3]) for i in range(0, len(frame), 3)]
+    out = bytearray()
+    lit = []
+    i = 0
+    while i < len(px):
+        run = 1
+        while i + run < len(px) and px[i + run] == px[i] and run < 128:
+            run += 1
+        if run >= 2:
+            if lit:
+                out += bytes((len(lit) - 1,)) + b''.join(lit)
+                lit = []
+            out += bytes((0x80 | (run - 1),)) + px[i]
+            i += run
+        else:
+            lit.append(px[i])
+            if len(lit) == 128:
+                out += bytes((127,)) + b''.join(lit)
+                lit = []
+            i += 1
+    if lit:
+        out += bytes((len(lit) - 1,)) + b''.join(lit)
+    return struct.pack('<H', len(out)) + out
+
+
+def write(path, frames, pixels, ms, rle):
+    with open(path, 'wb') as f:
+        f.write(HDR.pack(MAGIC, 1, RLE if rle else 0, pixels, ms, len(frames)))  # r, g, b files still play on version 1 firmware
+        raw = enc = 0
+        for fr in frames:
+            data = rle_frame(fr) if rle else bytes(fr)
+            f.write(data)
+            raw += len(fr)
+            enc += len(data)
+    print('%s: %d frames of %d pixels, %d mS/frame, %d bytes of frames (%d raw)' %
+          (path, len(frames), pixels, ms, enc, raw))
+
+
+def make_palette(frames, colors):
+    """the most used colors, and each frame as indices into them"""
+    count = collections.Counter()
+    for fr in frames:
+        count.update(bytes(fr[i:i + 3]) for i in range(0, len(fr), 3))
+    palette = [c for c, _ in count.most_common(colors)]
+    palette += [b'\x00\x00\x00'] * (colors - len(palette))
+    index = {c: i for i, c in enumerate(palette)}
+
+    def nearest(c):
+        if c not in index:
+            index[c] = min(range(colors), key=lambda i: sum((a - b) ** 2 for a, b in zip(c, palette[i])))
+        return index[c]
+
+    return palette, [[nearest(bytes(fr[i:i + 3])) for i in range(0, len(fr), 3)] for fr in frames]
+
+
+def write_palette(path, palette, frames, pixels, ms, updates=None):
+    """frames are lists of indices; updates (optional) is a list per frame of (index, (r, g, b))"""
+    colors = len(palette)
+    flags = (PAL16 if colors == 16 else PAL256) | (PALANIM if updates else 0)
+    with open(path, 'wb') as f:
+        f.write(HDR.pack(MAGIC, VERSION, flags, pixels, ms, len(frames)))
+        f.write(b''.join(palette))
+        enc = 0
+        for n, fr in enumerate(frames):
+            data = bytearray()
+            if updates:
+                if len(updates[n]) > PAL_UPDATES:
+                    sys.exit('frame %d changes %d palette entries, the most is %d' % (n, len(updates[n]), PAL_UPDATES))
+                data.append(len(updates[n]))
+                for i, rgb in updates[n]:
+                    data += bytes((i,) + tuple(rgb))
+            if colors == 16:
+                fr = list(fr) + [0] * (len(fr) & 1)
+                data += bytes((fr[i] << 4) | fr[i + 1] for i in range(0, len(fr), 2))
+            else:
+                data += bytes(fr)
+            f.write(data)
+            enc += len(data)
+    print('%s: %d frames of %d pixels, %d mS/frame, %d colors%s, %d bytes of frames (%d raw)' %
+          (path, len(frames), pixels, ms, colors, ' (animated)' if updates else '', enc, len(frames) * pixels * 3))
+
+
+def encode(args):
+    size = args.pixels * 3
+    data = open(args.input, 'rb').read()
+    frames = [data[i:i + size] for i in range(0, len(data) - size + 1, size)]
+    if args.palette:
+        palette, frames = make_palette(frames, args.palette)
+        write_palette(args.output, palette, frames, args.pixels, args.ms)
+    else:
+        write(args.output, frames, args.pixels, args.ms, args.rle)
+
+
+def demo(args):
+    frames = []
+    n = args.pixels
+    for f in range(args.frames):
+        head = f * n // args.frames
+        fr = bytearray(b'\x00\x00\x08' * n)
+        for t in range(12):
+            p = head - t
+            if 0 <= p < n:
+                v = 255 >> t // 2
+                fr[p * 3:p * 3 + 3] = bytes((v, v // 2, 0))
+        frames.append(fr)
+    if args.palette:
+        palette, frames = make_palette(frames, args.palette)
+        updates = None
+        if args.cycle:
+            bg = palette.index(b'\x00\x00\x08')
+            updates = [[(bg, (0, 0, 4 + int(12 * (1 - math.cos(2 * math.pi * f / args.frames)))))]
+                       for f in range(args.frames)]
+        write_palette(args.output, palette, frames, n, args.ms, updates)
+    else:
+        write(args.output, frames, n, args.ms, args.rle)
+
+
+def info(args):
+    with open(args.input, 'rb') as f:
+        magic, ver, flags, pixels, ms, frames = HDR.unpack(f.read(HDR.size))
+    if magic != MAGIC:
+        sys.exit('%s is not an animation file' % args.input)
+    colors = 16 if flags & PAL16 else (256 if flags & PAL256 else 0)
+    print('version %d, %d pixels, %d frames, %d mS/frame%s%s%s' %
+          (ver, pixels, frames, ms, ', RLE' if flags & RLE else '',
+           ', %d colors' % colors if colors else '', ' (animated)' if flags & PALANIM else ''))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    sub = ap.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('encode')
+    p.add_argument('input')
+    p.add_argument('output')
+    p.add_argument('--pixels', type=int, required=True)
+    p.add_argument('--ms', type=int, default=33)
+    p.add_argument('--rle', action='store_true')
+    p.add_argument('--palette', type=int, choices=(16, 256))
+    p = sub.add_parser('demo')
+    p.add_argument('output')
+    p.add_argument('--pixels', type=int, default=300)
+    p.add_argument('--frames', type=int, default=90)
+    p.add_argument('--ms', type=int, default=33)
+    p.add_argument('--rle', action='store_true')
+    p.add_argument('--palette', type=int, choices=(16, 256))
+    p.add_argument('--cycle', action='store_true')
+    p = sub.add_parser('info')
+    p.add_argument('input')
+    args = ap.parse_args()
+    {'encode': encode, 'demo': demo, 'info': info}[args.cmd](args)
+
+
+if __name__ == '__main__':
+    main()
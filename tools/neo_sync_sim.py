@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+#
+# board sync (neo_sync.cpp) test tool
+#
+#   tools/neo_sync_sim.py sim [--nodes N] [--minutes M] [--ppm P] [--jitter-ms J]
+#       runs a leader and N followers in this process, passing the real
+#       packets over loopback udp, each follower with its own clock drift
+#       and random network delay.  the followers use the same estimator as
+#       neo_sync.cpp.  time is simulated so minutes run in a second or so.
+#       prints the worst clock error between boards and how far apart a
+#       sequence of 1 second points started with a play command gets.
+#
+#   tools/neo_sync_sim.py leader [--broadcast 192.168.1.255]
+#       be the leader for real boards (set to follower) on the network
+#
+#   tools/neo_sync_sim.py play <label> [--file /neo_user_1.json] [--broadcast ...]
+#       send a play command to the boards, start time NEO_SYNC_LEAD_MS from now
+#       on the leader's clock (this tool's clock when it is the leader)
+#
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+PORT = 4210           # NEO_SYNC_PORT
+MAGIC = 0x3159534E    # "NSY1"
+BEACON_MS = 1000      # NEO_SYNC_BEACON_MS
+WINDOW = 8            # NEO_SYNC_WINDOW
+STEP_US = 50000       # NEO_SYNC_STEP_US
+LEAD_MS = 250         # NEO_SYNC_LEAD_MS
+MSG = struct.Struct('<IBBHIq32s32s')  # sync_msg_t
+BEACON, PLAY = 0, 1
+
+
+def pack(mtype, seq, time_us, label=b'', file=b''):
+    return MSG.pack(MAGIC, mtype, 0, seq & 0xFFFF, 0x51A51A, time_us, label, file)
+
+
+class Follower:
+    """same arithmetic as neo_sync.cpp"""
+
+    def __init__(self):
+        self.locked = False
+        self.offset = 0
+        self.skew = 0.0
+        self.ref = 0
+        self.win_count = 0
+        self.win_start = 0
+        self.win_max = 0
+        self.steps = 0
+
+    def shared(self, local):
+        return local + self.offset + int(self.skew * (local - self.ref))
+
+    def step(self, leader, local):
+        self.offset = leader - local
+        self.ref = local
+        self.locked = True
+        self.steps += 1
+        self.win_count = 0
+
+    def beacon(self, leader, local):
+        if not self.locked:
+            return self.step(leader, local)
+        err = leader - self.shared(local)
+        if self.win_count == 0:
+            self.win_start = local
+            self.win_max = err
+        else:
+            self.win_max = max(self.win_max, err)
+        self.win_count += 1
+        if self.win_count < WINDOW:
+            return
+        self.win_count = 0
+        if abs(self.win_max) > STEP_US:
+            return self.step(leader, local)
+        self.offset = self.shared(local) - local
+        self.ref = local
+        self.offset += int(self.win_max / 2)
+        if local > self.win_start:
+            self.skew += (self.win_max / (local - self.win_start)) / 16.0
+
+
+def sim(args):
+    rx = []
+    for _ in range(args.nodes):
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.bind(('127.0.0.1', 0))
+        rx.append(s)
+    tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    # local clock of node i at true time t (us): start offset + drift
+    start = [random.randint(0, 60_000_000) for _ in rx]
+    ppm = [random.uniform(-args.ppm, args.ppm) for _ in rx]
+    local = lambda i, t: int(start[i] + t * (1 + ppm[i] * 1e-6))
+    nodes = [Follower() for _ in rx]
+
+    play_at = None
+    worst_clock = worst_phase = 0
+    total_us = int(args.minutes * 60e6)
+    seq = 0
+    for t in range(0, total_us, BEACON_MS * 1000):
+        tx_pkt = pack(BEACON, seq, t)  # leader clock is true time
+        seq += 1
+        for i, s in enumerate(rx):
+            tx.sendto(tx_pkt, s.getsockname())
+            _, _, _, _, _, leader_us, _, _ = MSG.unpack(s.recv(MSG.size))
+            delay = int(random.expovariate(1.0 / (args.jitter_ms * 1000))) + 300
+            nodes[i].beacon(leader_us, local(i, t + delay))
+
+        # after a minute of settling, "press a button" on node 0
+        if play_at is None and t >= 60_000_000:
+            play_at = nodes[0].shared(local(0, t)) + LEAD_MS * 1000
+
+        # check every board at a few points in between beacons
+        if play_at is not None:
+            for dt in (0, 250_000, 500_000, 750_000):
+                tt = t + dt
+                shared = [n.shared(local(i, tt)) for i, n in enumerate(nodes)]
+                worst_clock = max(worst_clock, max(shared) - min(shared), max(abs(x - tt) for x in shared))
+                # sequence of 1000 mS points: which point and how far into it
+                phase = [(x - play_at) for x in shared if x >= play_at]
+                if len(phase) == len(shared):
+                    worst_phase = max(worst_phase, max(phase) - min(phase))
+
+    print('%d followers, %.1f minutes, +/-%.0f ppm, %.1f mS mean extra delay' %
+          (args.nodes, args.minutes, args.ppm, args.jitter_ms))
+    print('steps per follower: %s' % [n.steps for n in nodes])
+    print('skew estimates (ppm): %s  actual: %s' %
+          (['%.1f' % (n.skew * 1e6) for n in nodes], ['%.1f' % -p for p in ppm]))
+    print('worst clock error after lock: %.2f mS' % (worst_clock / 1000))
+    print('worst sequence phase difference between boards: %.2f mS' % (worst_phase / 1000))
+
+
+def leader(args):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    seq = 0
+    while True:
+        s.sendto(pack(BEACON, seq, time.monotonic_ns() // 1000), (args.broadcast, PORT))
+        seq += 1
+        time.sleep(BEACON_MS / 1000)
+
+
+def play(args):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    at = time.monotonic_ns() // 1000 + LEAD_MS * 1000
+    s.sendto(pack(PLAY, 0, at, args.label.encode(), args.file.encode()), (args.broadcast, PORT))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    sub = ap.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('sim')
+    p.add_argument('--nodes', type=int, default=4)
+    p.add_argument('--minutes', type=float, default=30)
+    p.add_argument('--ppm', type=float, default=50)
+    p.add_argument('--jitter-ms', type=float, default=2)
+    p = sub.add_parser('leader')
+    p.add_argument('--broadcast', default='255.255.255.255')
+    p = sub.add_parser('play')
+    p.add_argument('label')
+    p.add_argument('--file', default='')
+    p.add_argument('--broadcast', default='255.255.255.255')
+    args = ap.parse_args()
+    {'sim': sim, 'leader': leader, 'play': play}[args.cmd](args)
+
+
+if __name__ == '__main__':
+    main()
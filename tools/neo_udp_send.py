@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# send a moving rainbow to the controller as a DDP or E1.31 pixel stream
+# (for testing neo_udp.cpp; counters are in http://<controller>/$netinfo)
+#
+#   tools/neo_udp_send.py <controller ip> [--pixels N] [--fps F] [--seconds S] [--e131]
+#
+# --drop P randomly skips P percent of the packets and --shuffle swaps the
+# order of some, so the dropped/late counters can be checked.
+#
+
+import argparse
+import colorsys
+import random
+import socket
+import struct
+import time
+
+DDP_PORT = 4048
+E131_PORT = 5568
+E131_UNIVERSE = 1       # NEO_E131_UNIVERSE
+E131_UNIV_CHAN = 510
+DDP_MAX_DATA = 1440     # keep DDP packets inside one ethernet frame
+
+
+def frame(pixels, t):
+    data = bytearray()
+    for i in range(pixels):
+        r, g, b = colorsys.hsv_to_rgb(((i / pixels) + t) % 1.0, 1.0, 0.5)
+        data += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return data
+
+
+def ddp_packets(data, seq):
+    pkts = []
+    for off in range(0, len(data), DDP_MAX_DATA):
+        chunk = data[off:off + DDP_MAX_DATA]
+        push = 0x01 if off + DDP_MAX_DATA >= len(data) else 0
+        seq = seq % 15 + 1
+        # flags (v1, push), sequence, data type (RGB 8 bit), id (display), offset, length
+        pkts.append(struct.pack('>BBBBIH', 0x40 | push, seq, 0x0B, 1, off, len(chunk)) + chunk)
+    return pkts, seq
+
+
+def e131_packets(data, seq, cid):
+    pkts = []
+    for u, off in enumerate(range(0, len(data), E131_UNIV_CHAN)):
+        chunk = bytes(data[off:off + E131_UNIV_CHAN])
+        n = len(chunk)
+        seq[u] = (seq.get(u, 255) + 1) % 256
+        root = struct.pack('>HH12sHI16s', 0x0010, 0, b'ASC-E1.17\0\0\0',
+                           0x7000 | (110 + n), 0x00000004, cid)
+        framing = struct.pack('>HI64sBHBBH', 0x7000 | (88 + n), 0x00000002,
+                              b'neo_udp_send', 100, 0, seq[u], 0, E131_UNIVERSE + u)
+        dmp = struct.pack('>HBBHHHB', 0x7000 | (11 + n), 0x02, 0xA1, 0, 1, n + 1, 0)
+        pkts.append(root + framing + dmp + chunk)
+    return pkts
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('host')
+    ap.add_argument('--pixels', type=int, default=10)
+    ap.add_argument('--fps', type=float, default=40)
+    ap.add_argument('--seconds', type=float, default=10)
+    ap.add_argument('--e131', action='store_true')
+    ap.add_argument('--drop', type=float, default=0)
+    ap.add_argument('--shuffle', action='store_true')
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    port = E131_PORT if args.e131 else DDP_PORT
+    cid = bytes(random.getrandbits(8) for _ in range(16))
+    ddp_seq = 0
+    e131_seq = {}
+    sent = skipped = 0
+    held = None
+
+    start = time.time()
+    n = 0
+    while time.time() - start < args.seconds:
+        data = frame(args.pixels, n / 100.0)
+        if args.e131:
+            pkts = e131_packets(data, e131_seq, cid)
+        else:
+            pkts, ddp_seq = ddp_packets(data, ddp_seq)
+        for p in pkts:
+            if random.random() * 100 < args.drop:
+                skipped += 1
+                continue
+            if args.shuffle and held is None and random.random() < 0.05:
+                held = p  # send it after the next one, it arrives late
+                continue
+            sock.sendto(p, (args.host, port))
+            sent += 1
+            if held is not None:
+                sock.sendto(held, (args.host, port))
+                sent += 1
+                held = None
+        n += 1
+        time.sleep(max(0, start + n / args.fps - time.time()))
+
+    print('%d frames, %d packets sent, %d dropped on purpose' % (n, sent, skipped))
+
+
+if __name__ == '__main__':
+    main()
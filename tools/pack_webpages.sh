@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# build the set of files to upload to the controller's LittleFS
+# (via http://<controller>/$upload.htm) from webpages/
+#
+#   tools/pack_webpages.sh [output directory] [BlackOpsOne-Regular.ttf]
+#
+# - text assets (htm, js, css, json, svg) are written as name.gz only;
+#   the web server sends them with Content-Encoding: gzip
+# - already compressed assets (png, woff2) are copied as they are
+# - config.html is copied as it is too: the soft AP config server
+#   (configSoftAP.cpp) reads it from the file system and streams it
+#   out in front of the form, with no gzip handling
+# - if the Black Ops One ttf is given (from fonts.google.com) it's cut down
+#   to printable ASCII and written as BlackOpsOne-subset.woff2
+#   (needs pyftsubset from python fonttools with brotli)
+#
+# NOTE: don't upload both name and name.gz, the plain one just wastes flash.
+#
+
+set -e
+
+SRC=$(dirname "$0")/../webpages
+OUT=${1:-webpages_packed}
+FONT=$2
+
+mkdir -p "$OUT"
+
+for f in "$SRC"/*; do
+  name=$(basename "$f")
+  case "$name" in
+    config.html)
+      cp "$f" "$OUT/$name"
+      ;;
+    *.htm|*.html|*.js|*.css|*.json|*.svg)
+      # -n so the output only changes when the content does
+      gzip -9 -n -c "$f" > "$OUT/$name.gz"
+      ;;
+    *)
+      cp "$f" "$OUT/$name"
+      ;;
+  esac
+done
+
+if [ -n "$FONT" ]; then
+  pyftsubset "$FONT" --unicodes="U+0020-007E" --flavor=woff2 \
+             --layout-features='' --no-hinting \
+             --output-file="$OUT/BlackOpsOne-subset.woff2"
+fi
+
+ls -l "$OUT"
@@ -1,17 +1,86 @@
+/*
+ * persistent websocket to the controller.  button presses go over it
+ * when it's open (no new connection per press) and the controller pushes
+ * the sequence that is playing so every page highlights the same button.
+ * falls back to POST /api/button while the socket is down.
+ */
+let neoSocket = null;
+const WS_RETRY_MS = 2000;
+
+function wsConnect()  {
+  neoSocket = new WebSocket('ws://' + location.host + '/ws');
+  neoSocket.onmessage = (event) => {
+    let msg;
+    try {
+      msg = JSON.parse(event.data);
+    } catch(e) {
+      console.error('Bad websocket message:', event.data);
+      return;
+    }
+    if(msg.type == 'state')
+      showPlaying(msg.playing ? msg.sequence : null);
+    else if(msg.type == 'error')
+      window.alert("Error processing button press");
+  };
+  neoSocket.onclose = () => {
+    neoSocket = null;
+    setTimeout(wsConnect, WS_RETRY_MS);
+  };
+  neoSocket.onerror = () => neoSocket.close();
+}
+
+/*
+ * mark the button whose value matches the playing sequence (null for none)
+ */
+function showPlaying(sequence)  {
+  document.querySelectorAll('.color-control-button').forEach(button => {
+    button.classList.toggle('active', sequence != null && button.value == sequence);
+  });
+}
+
+wsConnect();
+
+/*
+ * add a button for each sequence file the controller has indexed,
+ * ahead of the STOP button (the built-ins are already in the page)
+ */
+function loadSequenceButtons()  {
+  fetch('/api/sequences')
+  .then(response => response.json())
+  .then(list => {
+    const stop = document.getElementById('stop');
+    list.sequences.filter(seq => !seq.builtin).forEach(seq => {
+      const button = document.createElement('button');
+      button.className = 'color-control-button';
+      button.value = seq.label;
+      button.id = seq.label.toLowerCase();
+      button.dataset.file = seq.file;
+      button.title = seq.file + ' (' + seq.strategy + ', ' + seq.points + ' points)';
+      button.textContent = seq.label;
+      button.onclick = () => callCFunction(button);
+      stop.parentNode.insertBefore(button, stop);
+    });
+  })
+  .catch(error => console.error('Error loading the sequence list:', error));
+}
+
+loadSequenceButtons();
+
 /**
  * Handles button click events by sending button data to the server API
  * 
  * @param {HTMLElement} targetElement - The button element that was clicked
  * @description 
  * This function takes a button element, extracts its value and data-file attributes,
- * and sends them to the server via a POST request to /api/button.
+ * and sends them to the server over the websocket if it is open, otherwise
+ * via a POST request to /api/button.
  * The data is sent as JSON in the format:
  * {
  *   sequence: <button value>,
  *   file: <data-file attribute value>
  * }
  * 
- * On success (status 201), the server response is logged to console.
+ * On success (status 202, the press is queued), the server response is logged to console.
  * On error, an alert is shown to the user and the error is logged.
  */
 function callCFunction(targetElement)  {
@@ -20,14 +89,18 @@ function callCFunction(targetElement)  {
     file: String(targetElement.dataset.file)
   }
   let jsonData = JSON.stringify(seq_data);
-  console.log(jsonData)  // this works ... how to get to c callback in server.on?
+  console.log(jsonData)
+  if(neoSocket != null && neoSocket.readyState == WebSocket.OPEN)  {
+    neoSocket.send(JSON.stringify({ cmd: 'play', ...seq_data }));
+    return;
+  }
   fetch('/api/button', {
     method: 'POST',
     headers: { 'Content-Type': 'application/json' },
     body: jsonData
   })
   .then(response => {
-    if(response.status != 201) {
+    if(response.status != 202) {
       window.alert("Error processing button press");
     }
     return response.text();